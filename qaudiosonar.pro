@@ -21,8 +21,11 @@ SOURCES         += src/qaudiosonar.cpp
 SOURCES         += src/qaudiosonar_button.cpp
 SOURCES         += src/qaudiosonar_buttonmap.cpp
 SOURCES         += src/qaudiosonar_configdlg.cpp
+SOURCES         += src/qaudiosonar_conv.cpp
 SOURCES         += src/qaudiosonar_correlation.cpp
+SOURCES         += src/qaudiosonar_cqt.cpp
 SOURCES         += src/qaudiosonar_display.cpp
+SOURCES         += src/qaudiosonar_fft.cpp
 SOURCES         += src/qaudiosonar_ftt.cpp
 SOURCES         += src/qaudiosonar_iso.cpp
 SOURCES         += src/qaudiosonar_mainwindow.cpp
@@ -32,6 +35,7 @@ SOURCES         += src/qaudiosonar_oss.cpp
 SOURCES         += src/qaudiosonar_siggen.cpp
 SOURCES         += src/qaudiosonar_spectrum.cpp
 SOURCES         += src/qaudiosonar_wave.cpp
+SOURCES         += src/qaudiosonar_yin.cpp
 
 macx {
 HEADERS		+= mac/activity.h
@@ -0,0 +1,15 @@
+#
+# QMAKE project file for the fixed point phase test
+#
+TEMPLATE        = app
+CONFIG          += qt warn_on release console
+CONFIG          -= app_bundle
+QT		+= core gui widgets
+
+HEADERS         += src/qaudiosonar.h
+SOURCES         += src/qaudiosonar_ftt.cpp
+SOURCES         += src/qaudiosonar_ftt_test.cpp
+
+TARGET          = qaudiosonar_ftt_test
+
+LIBS            += -lpthread -lm
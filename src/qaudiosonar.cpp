@@ -85,8 +85,22 @@ static void
 usage(void)
 {
 	fprintf(stderr, "Usage: qaudiosonar "
-	    "[-n <workers>] [-w <windowsize>]\n"
-	    "\t" "-r <samplerate: 8000, 9600, 12000, 16000, 24000, 48000>\n");
+	    "[-n <workers>] [-w <windowsize>] [-i] [-f] [-p] [-q] [-s] [-k] [-c] [-z] [-d] [-g] [-m <sources>] [-x]\n"
+	    "\t" "-r <samplerate: 8000, 9600, 12000, 16000, 24000, 48000>\n"
+	    "\t" "-i incremental sliding window frequency analysis\n"
+	    "\t" "-f fixed point phase for the triangular waves\n"
+	    "\t" "-p decimated octave pyramid for the low frequency bands\n"
+	    "\t" "-q constant-Q analysis length per frequency band\n"
+	    "\t" "-s parabolic interpolation instead of binary search for peaks\n"
+	    "\t" "-k skip quiet frequency bands most of the time, not with -i\n"
+	    "\t" "-c correlate in the frequency domain\n"
+	    "\t" "-z correlate only the zoomed lags at full rate\n"
+	    "\t" "-d delay finder, correlate at full rate only around the peaks\n"
+	    "\t" "-g phase transform weighted correlation, implies -c, not with -d\n"
+	    "\t" "-m additional correlation channels, as source numbers 0-5:\n"
+	    "\t" "   input 0, 1, 0+1, output 0, 1, 0+1; the audio backends only\n"
+	    "\t" "   provide two channels, and only -c shares work between channels\n"
+	    "\t" "-x single precision x3 multiplier for correlation and filtering\n");
 	exit(0);
 }
 
@@ -96,7 +110,7 @@ main(int argc, char **argv)
 	QApplication app(argc, argv);
 	int c;
 
-	while ((c = getopt(argc, argv, "n:r:hw:")) != -1) {
+	while ((c = getopt(argc, argv, "cdfgikm:n:pqr:hsw:xz")) != -1) {
 		switch (c) {
 		case 'n':
 			qas_num_workers = atoi(optarg);
@@ -117,12 +131,62 @@ main(int argc, char **argv)
 		case 'w':
 			qas_window_size = atoi(optarg);
 			break;
+		case 'i':
+			qas_wave_incremental = 1;
+			break;
+		case 'f':
+			qas_ftt_fixed = 1;
+			break;
+		case 'p':
+			qas_wave_pyramid = 1;
+			break;
+		case 'q':
+			qas_wave_constant_q = 1;
+			break;
+		case 's':
+			qas_wave_interpolate = 1;
+			break;
+		case 'k':
+			qas_wave_sparse = 1;
+			break;
+		case 'c':
+			qas_corr_fft = 1;
+			break;
+		case 'z':
+			qas_corr_zoom = 1;
+			break;
+		case 'd':
+			qas_corr_delay = 1;
+			break;
+		case 'g':
+			qas_corr_phat = 1;
+			qas_corr_fft = 1;
+			break;
+		case 'm':
+			for (const char *ps = optarg; *ps != 0; ps++) {
+				if (*ps < '0' || *ps > '5' ||
+				    qas_corr_channels == QAS_CORR_CHANNELS_MAX)
+					usage();
+				qas_corr_source[qas_corr_channels++] = *ps - '0';
+			}
+			break;
+		case 'x':
+			qas_x3_float = 1;
+			break;
 		default:
 			usage();
 			break;
 		}
 	}
 
+	/* the incremental sums must be fed every band of every frame */
+	if (qas_wave_sparse && qas_wave_incremental)
+		errx(1, "The -k and -i options cannot be combined\n");
+
+	/* the delay finder correlates in the time domain */
+	if (qas_corr_phat && qas_corr_delay)
+		errx(1, "The -g and -d options cannot be combined\n");
+
 	atomic_init();
 
 	/* range check window size */
@@ -142,7 +206,13 @@ main(int argc, char **argv)
 
 	qas_mw = new QasMainWindow();
 
+	qas_x3_init();
+	qas_ftt_init();
+	qas_fft_init();
+	qas_conv_init();
 	qas_wave_init();
+	qas_yin_init();
+	qas_cqt_init();
 	qas_corr_init();
 	qas_display_init();
 	qas_midi_init();
@@ -133,7 +133,13 @@ void atomic_wakeup();
 
 /* ============== MULTIPLY SUPPORT ============== */
 
+extern int qas_x3_float;
+
 void qas_x3_multiply_double(double *, double *, double *, const size_t);
+void qas_x3_multiply_double_as_float(const double *, const double *, double *, const size_t);
+void qas_x3_batch_double(const double *, const size_t, const double *, double *, const size_t, const size_t, const size_t);
+void qas_x3_batch_double_as_float(const double *, const size_t, const double *, double *, const size_t, const size_t, const size_t);
+void qas_x3_init();
 
 /* ============== WAVE SUPPORT ============== */
 
@@ -141,11 +147,23 @@ extern double qas_tuning;
 extern double *qas_freq_table;
 extern uint8_t *qas_iso_table;
 extern size_t qas_num_bands;
-extern QString *qas_descr_table;
+extern size_t qas_band_start;
+extern size_t qas_band_stop;
+extern int qas_wave_incremental;
+extern int qas_wave_pyramid;
+extern int qas_wave_constant_q;
+extern int qas_wave_interpolate;
+extern int qas_wave_sparse;
+extern int qas_engine;
+#define	QAS_ENGINE_TRIANGLE 0
+#define	QAS_ENGINE_YIN 1
+#define	QAS_ENGINE_CQT 2
+#define	QAS_ENGINE_GOERTZEL 3
 
 struct qas_wave_job {
 	TAILQ_ENTRY(qas_wave_job) entry;
 	size_t band_start;
+	size_t band_count;
 	struct qas_corr_data *data;
 };
 
@@ -158,10 +176,23 @@ extern void qas_wave_wait();
 extern void qas_wave_lock();
 extern void qas_wave_unlock();
 extern void qas_wave_init();
+extern void qas_wave_reset();
+extern void qas_wave_pyramid_build(struct qas_corr_data *);
+extern double qas_wave_refine_cost();
+extern QString qas_descr(size_t);
+extern size_t qas_wave_freq_to_band(double);
+extern void qas_wave_tuner(struct qas_corr_data *, size_t);
+extern void qas_wave_sparse_select(struct qas_corr_data *, uint8_t *);
+extern void qas_wave_sparse_update(const double *, const uint8_t *, double);
 
 /* ============== CORRELATION SUPPORT ============== */
 
 #define	QAS_CORR_SIZE QAS_MUL_SIZE
+#define	QAS_CORR_REFRESH 8	/* frames, for lags outside the zoom range */
+#define	QAS_CORR_DECIMATE 8	/* delay finder coarse decimation factor */
+#define	QAS_CORR_REFINE 16	/* delay finder full rate lags around each peak */
+#define	QAS_CORR_PHAT_GAIN (2.0 * QAS_CORR_SIZE)	/* undoes the inverse FFT scaling */
+#define	QAS_CORR_CHANNELS_MAX 8
 
 struct qas_corr_data {
 	TAILQ_ENTRY(qas_corr_data) entry;
@@ -170,14 +201,25 @@ struct qas_corr_data {
 	size_t state;
 #define	QAS_STATE_1ST_SCAN 0
 #define	QAS_STATE_2ND_SCAN 1
-	double *monitor_data;
-	double *input_data;
-	double *corr_data;
+	int engine;
+	size_t pitch_band;	/* fundamental found by the engine, if any */
+	size_t generation;	/* monitor buffer generation */
+	int dropped;		/* stale frame, not analyzed */
+	double *monitor_data;	/* read-only view of the monitor ring */
+	double *input_data;	/* reversed, one block per channel */
 	double *band_data;
+	double *pyramid_data;
 	double internal_data[];
 };
 
-extern double *qas_mon_decay;
+extern int qas_corr_fft;
+extern int qas_corr_zoom;
+extern int qas_corr_delay;
+extern int qas_corr_phat;
+extern size_t qas_corr_channels;
+extern int qas_corr_source[QAS_CORR_CHANNELS_MAX];	/* channel 0 uses qas_source_1 */
+extern size_t qas_corr_lag_start;
+extern size_t qas_corr_lag_stop;
 extern struct qas_corr_data *qas_corr_alloc(void);
 extern void qas_corr_free(struct qas_corr_data *);
 extern void qas_corr_insert(struct qas_corr_data *);
@@ -187,12 +229,40 @@ extern void qas_corr_wait();
 extern void qas_corr_lock();
 extern void qas_corr_unlock();
 extern void qas_corr_init();
+extern const double *qas_corr_decay_snapshot();
+extern void qas_corr_decay_reset();
+
+/* ============== YIN SUPPORT ============== */
+
+extern size_t qas_yin_analyze(const struct qas_corr_data *, double *);
+extern void qas_yin_init();
+
+/* ============== CQT SUPPORT ============== */
+
+extern void qas_cqt_analyze(struct qas_corr_data *);
+extern void qas_cqt_retune();
+extern void qas_cqt_init();
+
+/* ============== FFT SUPPORT ============== */
+
+#define	QAS_FFT_ORDER_MAX 15	/* 32768 points */
+
+extern void qas_fft_forward(double *, double *, uint8_t);
+extern void qas_fft_inverse(double *, double *, uint8_t);
+extern void qas_fft_init();
+
+/* ============== CONVOLUTION SUPPORT ============== */
+
+extern void qas_conv_double(const double *, const double *, double *, const size_t);
+extern void qas_conv_batch_double(const double *, const size_t, const double *, double *, const size_t, const size_t, const size_t);
+extern void qas_conv_init();
 
 /* ============== DISPLAY SUPPORT ============== */
 
 extern double *qas_display_data;
 extern double *qas_display_band;
 extern size_t qas_display_hist_max;	/* power of two */
+extern int qas_tuner;
 
 extern void qas_display_job_insert(struct qas_wave_job *);
 extern struct qas_wave_job *qas_display_job_dequeue();
@@ -207,6 +277,7 @@ extern double *qas_display_get_band(size_t);
 extern size_t qas_display_band_width();
 extern size_t qas_display_height();
 extern size_t qas_display_lag();
+extern ssize_t qas_display_tuner_band();
 
 /* ============== ISO SUPPORT ============== */
 
@@ -234,6 +305,8 @@ extern unsigned dsp_write_space(struct dsp_buffer *);
 extern unsigned dsp_read_space(struct dsp_buffer *);
 extern unsigned dsp_monitor_space(struct dsp_buffer *);
 extern void qas_dsp_sync(void);
+extern void qas_dsp_release(size_t);
+extern size_t qas_dsp_generation(void);
 
 /* ============== MIDI SUPPORT ============== */
 
@@ -246,8 +319,17 @@ extern void qas_midi_delay_send(uint8_t);
 
 /* ============== FTT SUPPORT ============== */
 
+extern int qas_ftt_fixed;
+
 extern double qas_ftt_cos(double);
 extern double qas_ftt_sin(double);
+extern double qas_ftt_cos_fixed(uint32_t);
+extern double qas_ftt_sin_fixed(uint32_t);
+extern uint32_t qas_ftt_fixed_phase(double);
+extern void qas_ftt_multi(const double *, size_t, double *, const double *, double *, double *, size_t);
+extern void qas_ftt_goertzel(const double *, size_t, const double *, double *, double *, size_t);
+extern size_t qas_ftt_multi_width();
+extern void qas_ftt_init();
 
 /* ============== SOUND APIs ============== */
 
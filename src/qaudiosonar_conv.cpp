@@ -0,0 +1,233 @@
+/*-
+ * Copyright (c) 2022 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "qaudiosonar.h"
+
+/*
+ * Each convolution size is computed either by the x3 multiplier or
+ * by FFT, whichever was faster when timed at startup. The x3
+ * multiplier wins at small sizes and FFT at large sizes, but the
+ * crossover depends on the CPU.
+ */
+#define	QAS_CONV_ORDER_MAX (QAS_FFT_ORDER_MAX - 1)
+#define	QAS_CONV_TIME_NUM 4	/* inputs per timed batch */
+#define	QAS_CONV_TIME_RUNS 5
+
+static uint8_t qas_conv_use_fft[QAS_CONV_ORDER_MAX + 1];
+
+/*
+ * FFT scratch space of each thread. It only grows, and is kept for
+ * the lifetime of the thread.
+ */
+static thread_local double *qas_conv_scratch;
+static thread_local size_t qas_conv_scratch_size;
+
+static double
+qas_conv_time()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1000000000.0);
+}
+
+static double *
+qas_conv_scratch_get(size_t size)
+{
+	if (qas_conv_scratch_size < size) {
+		double *ptr = (double *)realloc(qas_conv_scratch, sizeof(double) * size);
+
+		if (ptr == 0)
+			return (0);
+		qas_conv_scratch = ptr;
+		qas_conv_scratch_size = size;
+	}
+	return (qas_conv_scratch);
+}
+
+/*
+ * Convolve by FFT, zero padded to twice the input size. The fixed
+ * input is transformed once. The other inputs are real, so two of
+ * them are transformed at a time, one in the real part and one in
+ * the imaginary part.
+ */
+static bool
+qas_conv_fft(const double *va, const size_t va_stride, const double *vb,
+    double *pc, const size_t pc_stride, const size_t num, const uint8_t order)
+{
+	const size_t max = 1UL << order;
+	double *b_real;
+	double *b_imag;
+	double *real;
+	double *imag;
+
+	b_real = qas_conv_scratch_get(8 * max);
+	if (b_real == 0)
+		return (false);
+	b_imag = b_real + 2 * max;
+	real = b_imag + 2 * max;
+	imag = real + 2 * max;
+
+	memcpy(b_real, vb, sizeof(double) * max);
+	memset(b_real + max, 0, sizeof(double) * max);
+	memset(b_imag, 0, sizeof(double) * 2 * max);
+
+	qas_fft_forward(b_real, b_imag, order + 1);
+
+	for (size_t n = 0; n < num; n += 2) {
+		const bool pair = (n + 1 != num);
+
+		memcpy(real, va + n * va_stride, sizeof(double) * max);
+		memset(real + max, 0, sizeof(double) * max);
+		if (pair)
+			memcpy(imag, va + (n + 1) * va_stride, sizeof(double) * max);
+		else
+			memset(imag, 0, sizeof(double) * max);
+		memset(imag + max, 0, sizeof(double) * max);
+
+		qas_fft_forward(real, imag, order + 1);
+
+		for (size_t x = 0; x != 2 * max; x++) {
+			const double tr = real[x] * b_real[x] - imag[x] * b_imag[x];
+			const double ti = real[x] * b_imag[x] + imag[x] * b_real[x];
+
+			real[x] = tr;
+			imag[x] = ti;
+		}
+
+		qas_fft_inverse(real, imag, order + 1);
+
+		for (size_t x = 0; x != 2 * max; x++)
+			pc[n * pc_stride + x] += real[x];
+		if (pair) {
+			for (size_t x = 0; x != 2 * max; x++)
+				pc[(n + 1) * pc_stride + x] += imag[x];
+		}
+	}
+	return (true);
+}
+
+static void
+qas_conv_x3(const double *va, const size_t va_stride, const double *vb,
+    double *pc, const size_t pc_stride, const size_t num, const size_t max)
+{
+	if (qas_x3_float)
+		qas_x3_batch_double_as_float(va, va_stride, vb, pc, pc_stride, num, max);
+	else
+		qas_x3_batch_double(va, va_stride, vb, pc, pc_stride, num, max);
+}
+
+/*
+ * Same as qas_x3_batch_double(), using the method that was
+ * fastest for the given size.
+ */
+void
+qas_conv_batch_double(const double *va, const size_t va_stride, const double *vb,
+    double *pc, const size_t pc_stride, const size_t num, const size_t max)
+{
+	uint8_t order;
+
+	/* check for non-power of two */
+	if (max == 0 || (max & (max - 1)))
+		return;
+
+	for (order = 0; (1UL << order) != max; order++)
+		;
+
+	if (order <= QAS_CONV_ORDER_MAX && qas_conv_use_fft[order] &&
+	    qas_conv_fft(va, va_stride, vb, pc, pc_stride, num, order))
+		return;
+
+	qas_conv_x3(va, va_stride, vb, pc, pc_stride, num, max);
+}
+
+/*
+ * <input size> = "max"
+ * <output size> = 2 * "max"
+ *
+ * The convolution is added to the output.
+ */
+void
+qas_conv_double(const double *va, const double *vb, double *pc, const size_t max)
+{
+	qas_conv_batch_double(va, max, vb, pc, max, 1, max);
+}
+
+void
+qas_conv_init()
+{
+	unsigned wins = 0;
+
+	for (uint8_t order = 0; order <= QAS_CONV_ORDER_MAX; order++) {
+		const size_t max = 1UL << order;
+		const size_t loops = 1 + (QAS_MUL_SIZE >> order);
+		double *va;
+		double *vb;
+		double *pc;
+		double t_x3 = 1.0;
+		double t_fft = 1.0;
+
+		/* assume FFT keeps winning for larger sizes */
+		if (wins == 2) {
+			qas_conv_use_fft[order] = 1;
+			continue;
+		}
+
+		va = (double *)malloc(sizeof(double) *
+		    (QAS_CONV_TIME_NUM * max + max + (QAS_CONV_TIME_NUM + 1) * max));
+		if (va == 0)
+			break;
+		vb = va + QAS_CONV_TIME_NUM * max;
+		pc = vb + max;
+
+		for (size_t x = 0; x != (QAS_CONV_TIME_NUM + 1) * max; x++)
+			va[x] = (double)((x * 7919) % 255) - 127.0;
+		memset(pc, 0, sizeof(double) * (QAS_CONV_TIME_NUM + 1) * max);
+
+		/* allocate the scratch space before timing */
+		qas_conv_fft(va, max, vb, pc, max, QAS_CONV_TIME_NUM, order);
+
+		for (unsigned run = 0; run != QAS_CONV_TIME_RUNS; run++) {
+			double t0, t1, t2;
+
+			t0 = qas_conv_time();
+			for (size_t x = 0; x != loops; x++)
+				qas_conv_x3(va, max, vb, pc, max, QAS_CONV_TIME_NUM, max);
+			t1 = qas_conv_time();
+			for (size_t x = 0; x != loops; x++)
+				qas_conv_fft(va, max, vb, pc, max, QAS_CONV_TIME_NUM, order);
+			t2 = qas_conv_time();
+
+			if (t_x3 > t1 - t0)
+				t_x3 = t1 - t0;
+			if (t_fft > t2 - t1)
+				t_fft = t2 - t1;
+		}
+		free(va);
+
+		qas_conv_use_fft[order] = (t_fft < t_x3);
+		wins = qas_conv_use_fft[order] ? wins + 1 : 0;
+	}
+}
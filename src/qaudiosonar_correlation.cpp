@@ -23,6 +23,8 @@
  * SUCH DAMAGE.
  */
 
+#include <atomic>
+
 #include "qaudiosonar.h"
 
 static pthread_cond_t qas_corr_cond;
@@ -31,26 +33,131 @@ static pthread_mutex_t qas_corr_mutex;
 static TAILQ_HEAD(,qas_corr_data) qas_corr_head =
     TAILQ_HEAD_INITIALIZER(qas_corr_head);
 
-double *qas_mon_decay;
+/*
+ * The decayed correlation is published to the graph through a triple
+ * buffer, one window per channel. Under "qas_corr_decay_mutex", a
+ * worker computes the next state into the back buffer from the last
+ * published one, and swaps it into the middle buffer. The graph
+ * swaps it out again, so that painting never blocks the workers.
+ */
+#define	QAS_CORR_DECAY_FRESH 4U
+
+static pthread_mutex_t qas_corr_decay_mutex;
+static double *qas_corr_decay_buffer[3];
+static std::atomic<unsigned> qas_corr_decay_middle;
+static unsigned qas_corr_decay_back;	/* owned by the workers */
+static unsigned qas_corr_decay_latest;	/* owned by the workers, read-only */
+static unsigned qas_corr_decay_front;	/* owned by the graph */
+
+/*
+ * Decay accumulator.
+ */
+template <size_t N>
+static inline __attribute__((always_inline)) void
+qas_corr_decay_tmpl(double *dst, const double *prev, const double *src, double decay, double gain, size_t num)
+{
+	typedef double vec_t __attribute__((vector_size(N * sizeof(double))));
+	size_t x;
+
+	for (x = 0; x + N <= num; x += N) {
+		vec_t a;
+		vec_t b;
+
+		memcpy(&a, prev + x, sizeof(a));
+		memcpy(&b, src + x, sizeof(b));
+		a = a * decay + b * gain;
+		memcpy(dst + x, &a, sizeof(a));
+	}
+	for (; x != num; x++)
+		dst[x] = prev[x] * decay + src[x] * gain;
+}
+
+typedef void (qas_corr_decay_t)(double *, const double *, const double *, double, double, size_t);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("avx512f"))) static void
+qas_corr_decay_avx512(double *dst, const double *prev, const double *src, double decay, double gain, size_t num)
+{
+	qas_corr_decay_tmpl<8>(dst, prev, src, decay, gain, num);
+}
+
+__attribute__((target("avx2"))) static void
+qas_corr_decay_avx2(double *dst, const double *prev, const double *src, double decay, double gain, size_t num)
+{
+	qas_corr_decay_tmpl<4>(dst, prev, src, decay, gain, num);
+}
+#endif
+
+static void
+qas_corr_decay_generic(double *dst, const double *prev, const double *src, double decay, double gain, size_t num)
+{
+	qas_corr_decay_tmpl<2>(dst, prev, src, decay, gain, num);
+}
+
+static qas_corr_decay_t *qas_corr_decay_fn = &qas_corr_decay_generic;
+
+/*
+ * Compute "dst = prev * decay + src * gain" for "num" samples. The
+ * "dst" and "prev" arrays may be the same.
+ */
+static void
+qas_corr_decay(double *dst, const double *prev, const double *src, double decay, double gain, size_t num)
+{
+	qas_corr_decay_fn(dst, prev, src, decay, gain, num);
+}
+
+int qas_corr_fft;
+int qas_corr_zoom;
+int qas_corr_delay;
+int qas_corr_phat;
+size_t qas_corr_channels = 1;
+int qas_corr_source[QAS_CORR_CHANNELS_MAX];
+size_t qas_corr_lag_start;
+size_t qas_corr_lag_stop;
+
+/*
+ * The frequency domain correlator keeps the spectrum of each pair of
+ * adjacent monitor blocks, so that every pair is only transformed
+ * once. Extra spectra are kept for frames in flight.
+ */
+#define	QAS_CORR_ORDER (QAS_MUL_ORDER + 1)
+#define	QAS_CORR_SLACK 32
+
+struct qas_corr_spectrum {
+	pthread_mutex_t mutex;
+	size_t index;		/* block pair index */
+	size_t generation;
+	int valid;
+	double *real;
+	double *imag;
+};
+
+static struct qas_corr_spectrum *qas_corr_spectrum;
+static size_t qas_corr_spectra;
+
+/*
+ * The delay finder keeps a decayed correlation of decimated data,
+ * which is used to locate the peaks.
+ */
+static double *qas_corr_coarse_decay;
+static size_t qas_corr_coarse_generation;
 
 struct qas_corr_data *
 qas_corr_alloc(void)
 {
 	struct qas_corr_data *ptr;
 	const size_t size = sizeof(*ptr) + (
-	    qas_mon_size +
-	    QAS_CORR_SIZE +
-	    qas_mon_size + QAS_CORR_SIZE +
-	    (qas_num_bands / QAS_WAVE_STEP)
+	    QAS_CORR_SIZE * qas_corr_channels +
+	    (qas_num_bands / QAS_WAVE_STEP) +
+	    (qas_wave_pyramid ? qas_window_size : 0)
 	) * sizeof(double);
 
 	ptr = (struct qas_corr_data *)malloc(size);
 	if (ptr != 0) {
 		memset(ptr, 0, size);
-		ptr->monitor_data = ptr->internal_data;
-		ptr->input_data = ptr->monitor_data + qas_mon_size;
-		ptr->corr_data = ptr->input_data + QAS_CORR_SIZE;
-		ptr->band_data = ptr->corr_data + qas_mon_size + QAS_CORR_SIZE;
+		ptr->input_data = ptr->internal_data;
+		ptr->band_data = ptr->input_data + QAS_CORR_SIZE * qas_corr_channels;
+		ptr->pyramid_data = ptr->band_data + (qas_num_bands / QAS_WAVE_STEP);
 	}
 	return (ptr);
 }
@@ -58,6 +165,7 @@ qas_corr_alloc(void)
 void
 qas_corr_free(struct qas_corr_data *ptr)
 {
+	qas_dsp_release(ptr->sequence_number);
 	free(ptr);
 }
 
@@ -108,39 +216,518 @@ qas_corr_unlock()
 	pthread_mutex_unlock(&qas_corr_mutex);
 }
 
+/*
+ * Apply the phase transform, GCC-PHAT, to a cross spectrum, so that
+ * only the phase remains. Each bin is given a magnitude equal to the
+ * transform size, so that after the inverse transform a fully
+ * coherent delay gives a peak of one per bin, while uncorrelated
+ * input stays around the square root of that. This keeps the result
+ * independent of the input level and well above the unit floor of
+ * the graph.
+ */
+static void
+qas_corr_phat_weight(double *real, double *imag, size_t max)
+{
+	for (size_t x = 0; x != max; x++) {
+		const double mag = sqrt(real[x] * real[x] + imag[x] * imag[x]);
+
+		if (mag > 0.0) {
+			real[x] *= QAS_CORR_PHAT_GAIN / mag;
+			imag[x] *= QAS_CORR_PHAT_GAIN / mag;
+		}
+	}
+}
+
+/*
+ * Compute the correlation using uniformly partitioned overlap-save.
+ * The spectrum of block pair "x" of a frame is the spectrum of
+ * block pair "x - 1" of the following frame. If a spectrum is not
+ * available, it is computed from the monitor data of the frame.
+ * Each monitor spectrum is shared by all channels.
+ * Only the lag blocks from "start" to "stop" are computed. The
+ * "temp" buffer must hold "4 * QAS_CORR_SIZE" values per channel.
+ */
+static void
+qas_corr_fft_do(struct qas_corr_data *ptr, double *temp, double *corr, size_t start, size_t stop)
+{
+	const size_t max = 2 * QAS_CORR_SIZE;
+	const size_t stride = qas_mon_size + QAS_CORR_SIZE;
+	double *in_real;
+	double *in_imag;
+	double mon_real[max];
+	double mon_imag[max];
+	double real[max];
+	double imag[max];
+
+	in_real = temp;
+	in_imag = in_real + max * qas_corr_channels;
+
+	/* transform the reversed inputs, zero padded */
+	for (size_t ch = 0; ch != qas_corr_channels; ch++) {
+		memcpy(in_real + ch * max, ptr->input_data + ch * QAS_CORR_SIZE,
+		    sizeof(double) * QAS_CORR_SIZE);
+		memset(in_real + ch * max + QAS_CORR_SIZE, 0, sizeof(double) * QAS_CORR_SIZE);
+		memset(in_imag + ch * max, 0, sizeof(double) * max);
+
+		qas_fft_forward(in_real + ch * max, in_imag + ch * max, QAS_CORR_ORDER);
+	}
+
+	for (size_t x = start + 1; x != stop + 1; x++) {
+		const size_t index = ptr->sequence_number + x;
+		struct qas_corr_spectrum *ps = qas_corr_spectrum + (index % qas_corr_spectra);
+		int found;
+
+		pthread_mutex_lock(&ps->mutex);
+		found = (ps->valid && ps->index == index &&
+		    ps->generation == ptr->generation);
+		if (found) {
+			memcpy(mon_real, ps->real, sizeof(mon_real));
+			memcpy(mon_imag, ps->imag, sizeof(mon_imag));
+		}
+		pthread_mutex_unlock(&ps->mutex);
+
+		if (found == 0) {
+			memcpy(mon_real, ptr->monitor_data + (x - 1) * QAS_CORR_SIZE,
+			    sizeof(double) * max);
+			memset(mon_imag, 0, sizeof(mon_imag));
+
+			qas_fft_forward(mon_real, mon_imag, QAS_CORR_ORDER);
+
+			/* keep the spectrum, unless a newer one is present */
+			pthread_mutex_lock(&ps->mutex);
+			if (ps->valid == 0 || ps->generation < ptr->generation ||
+			    (ps->generation == ptr->generation && ps->index < index)) {
+				memcpy(ps->real, mon_real, sizeof(mon_real));
+				memcpy(ps->imag, mon_imag, sizeof(mon_imag));
+				ps->index = index;
+				ps->generation = ptr->generation;
+				ps->valid = 1;
+			}
+			pthread_mutex_unlock(&ps->mutex);
+		}
+
+		for (size_t ch = 0; ch != qas_corr_channels; ch++) {
+			const double *pr = in_real + ch * max;
+			const double *pi = in_imag + ch * max;
+
+			for (size_t y = 0; y != max; y++) {
+				real[y] = mon_real[y] * pr[y] - mon_imag[y] * pi[y];
+				imag[y] = mon_real[y] * pi[y] + mon_imag[y] * pr[y];
+			}
+
+			if (qas_corr_phat)
+				qas_corr_phat_weight(real, imag, max);
+
+			qas_fft_inverse(real, imag, QAS_CORR_ORDER);
+
+			/* the first half is wrapped around */
+			memcpy(corr + ch * stride + x * QAS_CORR_SIZE,
+			    real + QAS_CORR_SIZE, sizeof(double) * QAS_CORR_SIZE);
+		}
+	}
+}
+
+/*
+ * Compute the correlation of a channel for the lags from "start" to
+ * "stop" directly.
+ */
+static void
+qas_corr_direct(struct qas_corr_data *ptr, double *corr, size_t ch, size_t start, size_t stop)
+{
+	const double *in = ptr->input_data + ch * QAS_CORR_SIZE + QAS_CORR_SIZE - 1;
+	double *out = corr + ch * (qas_mon_size + QAS_CORR_SIZE) + QAS_CORR_SIZE;
+
+	for (size_t x = start; x != stop; x++) {
+		const double *pm = ptr->monitor_data + x + 1;
+		double sum = 0;
+
+		for (size_t y = 0; y != QAS_CORR_SIZE; y++)
+			sum += pm[y] * in[-(ssize_t)y];
+
+		out[x] = sum;
+	}
+}
+
+/*
+ * Locate the maximum and minimum of the correlation between the lags
+ * "start" and "stop", using decimated data, and compute the
+ * correlation at full rate only around those two peaks. All other
+ * lags are left at zero. The decimated monitor data is shared by all
+ * channels.
+ */
+static void
+qas_corr_delay_do(struct qas_corr_data *ptr, double *temp, double *corr, size_t start, size_t stop)
+{
+	const size_t csize = QAS_CORR_SIZE / QAS_CORR_DECIMATE;
+	const size_t cmon = qas_mon_size / QAS_CORR_DECIMATE;
+	const size_t cwin = qas_window_size / QAS_CORR_DECIMATE;
+	double *md = temp;
+	double *in = md + cmon;
+	double *cd = in + csize;
+	int update;
+
+	/* decimate */
+	for (size_t x = 0; x != cmon; x++) {
+		double sum = 0;
+		for (size_t y = 0; y != QAS_CORR_DECIMATE; y++)
+			sum += ptr->monitor_data[x * QAS_CORR_DECIMATE + y];
+		md[x] = sum;
+	}
+
+	start /= QAS_CORR_DECIMATE;
+	stop = (stop + QAS_CORR_DECIMATE - 1) / QAS_CORR_DECIMATE;
+
+	pthread_mutex_lock(&qas_corr_decay_mutex);
+	if (qas_corr_coarse_generation < ptr->generation) {
+		memset(qas_corr_coarse_decay, 0,
+		    sizeof(double) * cwin * qas_corr_channels);
+		qas_corr_coarse_generation = ptr->generation;
+	}
+	update = (qas_corr_coarse_generation == ptr->generation);
+	pthread_mutex_unlock(&qas_corr_decay_mutex);
+
+	for (size_t ch = 0; ch != qas_corr_channels; ch++) {
+		double *pdecay = qas_corr_coarse_decay + ch * cwin;
+
+		/* all other lags are zero */
+		memset(corr + ch * (qas_mon_size + QAS_CORR_SIZE) + QAS_CORR_SIZE, 0,
+		    sizeof(double) * qas_window_size);
+		const double *pin = ptr->input_data + ch * QAS_CORR_SIZE;
+		size_t peak[2];
+		size_t t;
+		size_t u;
+
+		for (size_t x = 0; x != csize; x++) {
+			double sum = 0;
+			for (size_t y = 0; y != QAS_CORR_DECIMATE; y++)
+				sum += pin[x * QAS_CORR_DECIMATE + y];
+			in[x] = sum;
+		}
+
+		/* coarse correlation */
+		memset(cd, 0, sizeof(double) * (cmon + csize));
+		qas_conv_batch_double(md, csize, in, cd, csize, cmon / csize, csize);
+
+		pthread_mutex_lock(&qas_corr_decay_mutex);
+		if (update)
+			qas_corr_decay(pdecay, pdecay, cd + csize, qas_view_decay, 1.0, cwin);
+		t = u = start;
+		for (size_t x = start; x != stop; x++) {
+			if (pdecay[x] > pdecay[t])
+				t = x;
+			if (pdecay[x] < pdecay[u])
+				u = x;
+		}
+		pthread_mutex_unlock(&qas_corr_decay_mutex);
+
+		/* coarse lag "x" is centered at full rate lag "x * D + D - 1" */
+		peak[0] = t * QAS_CORR_DECIMATE + QAS_CORR_DECIMATE - 1;
+		peak[1] = u * QAS_CORR_DECIMATE + QAS_CORR_DECIMATE - 1;
+
+		for (size_t x = 0; x != 2; x++) {
+			size_t a = (peak[x] > QAS_CORR_REFINE) ? (peak[x] - QAS_CORR_REFINE) : 0;
+			size_t b = peak[x] + QAS_CORR_REFINE + 1;
+
+			if (b > qas_window_size)
+				b = qas_window_size;
+			if (x == 1 && peak[1] == peak[0])
+				break;
+			qas_corr_direct(ptr, corr, ch, a, b);
+		}
+	}
+}
+
+/*
+ * Make the back buffer the middle one. Must be called with
+ * "qas_corr_decay_mutex" locked.
+ */
+static void
+qas_corr_decay_publish(void)
+{
+	qas_corr_decay_latest = qas_corr_decay_back;
+	qas_corr_decay_back = qas_corr_decay_middle.exchange(
+	    qas_corr_decay_back | QAS_CORR_DECAY_FRESH) & ~QAS_CORR_DECAY_FRESH;
+}
+
+/*
+ * Returns the latest published decayed correlation, one window per
+ * channel. The data stays valid until the next call. Must only be
+ * called from the graph.
+ */
+const double *
+qas_corr_decay_snapshot(void)
+{
+	if (qas_corr_decay_middle.load() & QAS_CORR_DECAY_FRESH) {
+		qas_corr_decay_front = qas_corr_decay_middle.exchange(
+		    qas_corr_decay_front) & ~QAS_CORR_DECAY_FRESH;
+	}
+	return (qas_corr_decay_buffer[qas_corr_decay_front]);
+}
+
+void
+qas_corr_decay_reset(void)
+{
+	pthread_mutex_lock(&qas_corr_decay_mutex);
+	memset(qas_corr_decay_buffer[qas_corr_decay_back], 0,
+	    sizeof(double) * qas_window_size * qas_corr_channels);
+	qas_corr_decay_publish();
+	pthread_mutex_unlock(&qas_corr_decay_mutex);
+}
+
+/*
+ * Pass a frame, which needs no 1st scan, directly to the display.
+ */
+static void
+qas_corr_skip(struct qas_corr_data *ptr)
+{
+	struct qas_wave_job *pjob;
+
+	ptr->refcount = 1;
+
+	pjob = qas_wave_job_alloc();
+	pjob->band_start = 0;
+	pjob->band_count = 0;
+	pjob->data = ptr;
+	qas_display_job_insert(pjob);
+}
+
 static void *
 qas_corr_worker(void *arg)
 {
 	QThread::currentThread()->setPriority(QThread::LowPriority);
 
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+	const size_t group = qas_ftt_multi_width();
+	const size_t blocks = qas_window_size / QAS_CORR_SIZE;
+	const size_t stride = qas_mon_size + QAS_CORR_SIZE;
+	uint8_t active[table_size];
+	double *coarse = 0;
+	double *spectra = 0;
+	double *corr;
+
+	/* correlation of the current frame, one per channel */
+	corr = (double *)malloc(sizeof(double) * stride * qas_corr_channels);
+
+	if (qas_corr_delay) {
+		coarse = (double *)malloc(sizeof(double) *
+		    (2 * qas_mon_size + 2 * QAS_CORR_SIZE) / QAS_CORR_DECIMATE);
+	}
+	if (qas_corr_fft) {
+		spectra = (double *)malloc(sizeof(double) *
+		    4 * QAS_CORR_SIZE * qas_corr_channels);
+	}
+
 	while (1) {
 		struct qas_corr_data *ptr;
 		struct qas_wave_job *pjob;
+		ssize_t tuner;
+		double amp;
+		int engine;
+		size_t jobs;
+		size_t start;
+		size_t stop;
+		size_t zoom_start;
+		size_t zoom_stop;
+		size_t lag_start;
+		size_t lag_stop;
 
 		ptr = qas_corr_job_dequeue();
 
-		ptr->refcount = qas_num_bands / QAS_WAVE_STEP;
+		/* drop frames whose monitor data was cleared by a reset */
+		if (ptr->generation != qas_dsp_generation()) {
+			memset(ptr->band_data, 0, sizeof(ptr->band_data[0]) * table_size);
+			ptr->pitch_band = 0;
+			ptr->dropped = 1;
+			qas_corr_skip(ptr);
+			continue;
+		}
+
+		/* get the zoomed lags */
+		atomic_graph_lock();
+		zoom_start = qas_corr_lag_start;
+		zoom_stop = qas_corr_lag_stop;
+		atomic_graph_unlock();
+
+		if (qas_corr_delay) {
+			qas_corr_delay_do(ptr, coarse, corr, zoom_start, zoom_stop);
+
+			/* the zoom range only limits the peak search */
+			zoom_start = 0;
+			zoom_stop = blocks;
+		} else {
+			zoom_start /= QAS_CORR_SIZE;
+			zoom_stop = (zoom_stop + QAS_CORR_SIZE - 1) / QAS_CORR_SIZE;
+		}
+
+		/* the other lags are only refreshed now and then */
+		if (qas_corr_delay || qas_corr_zoom == 0 ||
+		    (ptr->sequence_number % QAS_CORR_REFRESH) == 0) {
+			lag_start = 0;
+			lag_stop = blocks;
+		} else {
+			lag_start = zoom_start;
+			lag_stop = zoom_stop;
+		}
 
 		/* do correlation */
-		for (size_t x = 0; x != qas_mon_size; x += QAS_CORR_SIZE) {
-			qas_x3_multiply_double(ptr->monitor_data + x,
-			    ptr->input_data,
-			    ptr->corr_data + x, QAS_CORR_SIZE);
+		if (qas_corr_delay) {
+			/* already done */
+		} else if (qas_corr_fft) {
+			qas_corr_fft_do(ptr, spectra, corr, lag_start, lag_stop);
+		} else for (size_t ch = 0; ch != qas_corr_channels; ch++) {
+			/* the convolution is added, so clear the computed lags first */
+			memset(corr + ch * stride + lag_start * QAS_CORR_SIZE, 0,
+			    sizeof(double) * (lag_stop + 2 - lag_start) * QAS_CORR_SIZE);
+
+			/* lag block "x" depends on monitor blocks "x" and "x + 1" */
+			qas_conv_batch_double(ptr->monitor_data + lag_start * QAS_CORR_SIZE, QAS_CORR_SIZE,
+			    ptr->input_data + ch * QAS_CORR_SIZE,
+			    corr + ch * stride + lag_start * QAS_CORR_SIZE, QAS_CORR_SIZE,
+			    lag_stop + 1 - lag_start, QAS_CORR_SIZE);
 		}
 
-		atomic_graph_lock();
-		for (size_t x = 0; x != qas_window_size; x++) {
-			qas_mon_decay[x] *= qas_view_decay;
-			qas_mon_decay[x] += ptr->corr_data[x + QAS_CORR_SIZE];
+		pthread_mutex_lock(&qas_corr_decay_mutex);
+		for (size_t ch = 0; ch != qas_corr_channels; ch++) {
+			double *pdecay = qas_corr_decay_buffer[qas_corr_decay_back] + ch * qas_window_size;
+			const double *pprev = qas_corr_decay_buffer[qas_corr_decay_latest] + ch * qas_window_size;
+			const double *pcorr = corr + ch * stride + QAS_CORR_SIZE;
+
+			if (qas_corr_zoom == 0 || (zoom_start == 0 && zoom_stop == blocks)) {
+				qas_corr_decay(pdecay, pprev, pcorr, qas_view_decay, 1.0, qas_window_size);
+			} else {
+				const size_t a = lag_start * QAS_CORR_SIZE;
+				const size_t b = zoom_start * QAS_CORR_SIZE;
+				const size_t c = zoom_stop * QAS_CORR_SIZE;
+				const size_t d = lag_stop * QAS_CORR_SIZE;
+				double decay = 1.0;
+				double gain = 0.0;
+
+				/* make up for the frames skipped outside the zoom range */
+				for (size_t x = 0; x != QAS_CORR_REFRESH; x++) {
+					gain += decay;
+					decay *= qas_view_decay;
+				}
+
+				/* the lags which were not computed are kept */
+				memcpy(pdecay, pprev, sizeof(double) * a);
+				memcpy(pdecay + d, pprev + d, sizeof(double) * (qas_window_size - d));
+
+				if (a < b)
+					qas_corr_decay(pdecay + a, pprev + a, pcorr + a, decay, gain, b - a);
+				qas_corr_decay(pdecay + b, pprev + b, pcorr + b, qas_view_decay, 1.0, c - b);
+				if (c < d)
+					qas_corr_decay(pdecay + c, pprev + c, pcorr + c, decay, gain, d - c);
+			}
 		}
+		qas_corr_decay_publish();
+		pthread_mutex_unlock(&qas_corr_decay_mutex);
+
+		atomic_graph_lock();
+		start = qas_band_start / QAS_WAVE_STEP;
+		stop = qas_band_stop / QAS_WAVE_STEP;
+		engine = qas_engine;
 		atomic_graph_unlock();
 
+		ptr->engine = engine;
+
+		switch (engine) {
+			size_t y;
+		case QAS_ENGINE_YIN:
+			/* the pitch is computed directly */
+			memset(ptr->band_data, 0, sizeof(ptr->band_data[0]) * table_size);
+
+			ptr->pitch_band = qas_yin_analyze(ptr, &amp);
+			y = ptr->pitch_band / QAS_WAVE_STEP;
+
+			if (ptr->pitch_band != 0 && y >= start && y < stop)
+				ptr->band_data[y] = amp;
+			else
+				ptr->pitch_band = 0;
+
+			qas_corr_skip(ptr);
+			continue;
+		case QAS_ENGINE_CQT:
+			/* all bands are computed directly */
+			qas_cqt_analyze(ptr);
+
+			for (size_t x = 0; x != table_size; x++) {
+				if (x < start || x >= stop)
+					ptr->band_data[x] = 0;
+			}
+			ptr->pitch_band = 0;
+
+			qas_corr_skip(ptr);
+			continue;
+		default:
+			break;
+		}
+
+		/* compute the decimated monitor data, if any */
+		if (qas_wave_pyramid)
+			qas_wave_pyramid_build(ptr);
+
+		/* the tuner only analyzes the band it is locked to */
+		tuner = qas_display_tuner_band();
+		if (tuner > 0) {
+			qas_wave_tuner(ptr, tuner);
+			qas_corr_skip(ptr);
+			continue;
+		}
+
+		/* select bands to analyze */
+		if (qas_wave_sparse)
+			qas_wave_sparse_select(ptr, active);
+		else
+			memset(active, 1, sizeof(active));
+
+		/* only analyze the selected frequency range */
+		for (size_t x = 0; x != table_size; x++) {
+			if (x >= start && x < stop)
+				continue;
+			active[x] = 0;
+			ptr->band_data[x] = 0;
+		}
+
+		/* count jobs, one job per group of adjacent bands */
+		jobs = 0;
+		for (size_t x = 0; x != table_size; ) {
+			size_t y;
+
+			if (active[x] == 0) {
+				x++;
+				continue;
+			}
+			for (y = x; y != table_size && y - x != group && active[y]; y++)
+				;
+			jobs++;
+			x = y;
+		}
+
+		if (jobs == 0) {
+			/* nothing to analyze */
+			qas_corr_skip(ptr);
+			continue;
+		}
+
+		ptr->refcount = jobs;
+
 		/* generate jobs for output data */
-		for (size_t band = 0; band != qas_num_bands; band += QAS_WAVE_STEP) {
+		for (size_t x = 0; x != table_size; ) {
+			size_t y;
+
+			if (active[x] == 0) {
+				x++;
+				continue;
+			}
+			for (y = x; y != table_size && y - x != group && active[y]; y++)
+				;
+
 			pjob = qas_wave_job_alloc();
-			pjob->band_start = band;
+			pjob->band_start = x * QAS_WAVE_STEP;
+			pjob->band_count = y - x;
 			pjob->data = ptr;
 			qas_wave_job_insert(pjob);
+			x = y;
 		}
 	}
 	return (0);
@@ -152,8 +739,54 @@ qas_corr_init()
 	pthread_mutex_init(&qas_corr_mutex, 0);
 	pthread_cond_init(&qas_corr_cond, 0);
 
-	qas_mon_decay = (double *)malloc(sizeof(double) * qas_window_size);
-	memset(qas_mon_decay, 0, sizeof(double) * qas_window_size);
+	pthread_mutex_init(&qas_corr_decay_mutex, 0);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		qas_corr_decay_fn = &qas_corr_decay_avx512;
+	else if (__builtin_cpu_supports("avx2"))
+		qas_corr_decay_fn = &qas_corr_decay_avx2;
+#endif
+
+	for (size_t x = 0; x != 3; x++) {
+		qas_corr_decay_buffer[x] = (double *)malloc(sizeof(double) *
+		    qas_window_size * qas_corr_channels);
+		memset(qas_corr_decay_buffer[x], 0, sizeof(double) *
+		    qas_window_size * qas_corr_channels);
+	}
+	qas_corr_decay_front = 0;
+	qas_corr_decay_middle = 1;
+	qas_corr_decay_latest = 1;
+	qas_corr_decay_back = 2;
+
+	qas_corr_lag_start = 0;
+	qas_corr_lag_stop = qas_window_size;
+
+	if (qas_corr_delay) {
+		qas_corr_coarse_decay = (double *)malloc(sizeof(double) *
+		    qas_window_size / QAS_CORR_DECIMATE * qas_corr_channels);
+		memset(qas_corr_coarse_decay, 0, sizeof(double) *
+		    qas_window_size / QAS_CORR_DECIMATE * qas_corr_channels);
+	}
+
+	if (qas_corr_fft) {
+		qas_corr_spectra = qas_window_size / QAS_CORR_SIZE + QAS_CORR_SLACK;
+		qas_corr_spectrum = (struct qas_corr_spectrum *)
+		    malloc(sizeof(qas_corr_spectrum[0]) * qas_corr_spectra);
+
+		for (size_t x = 0; x != qas_corr_spectra; x++) {
+			struct qas_corr_spectrum *ps = qas_corr_spectrum + x;
+
+			pthread_mutex_init(&ps->mutex, 0);
+			ps->index = 0;
+			ps->generation = 0;
+			ps->valid = 0;
+			ps->real = (double *)malloc(sizeof(double) * 4 * QAS_CORR_SIZE);
+			ps->imag = ps->real + 2 * QAS_CORR_SIZE;
+		}
+	}
 
 	for (int i = 0; i != qas_num_workers; i++) {
 		pthread_t qas_corr_thread;
@@ -0,0 +1,314 @@
+/*-
+ * Copyright (c) 2022 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "qaudiosonar.h"
+
+/*
+ * Constant-Q transform using sparse spectral kernels, see "An
+ * efficient algorithm for the calculation of a constant Q transform"
+ * by J. C. Brown and M. S. Puckette.
+ */
+#define	QAS_CQT_THRESHOLD 0.005	/* relative to the kernel maximum */
+
+struct qas_cqt_kernel {
+	size_t offset;		/* first FFT bin */
+	size_t count;		/* number of FFT bins */
+	double *real;
+	double *imag;
+};
+
+/*
+ * A set of kernels for one tuning. Workers hold a reference while
+ * applying a set, so that a new set can be published while the old
+ * one is still in use.
+ */
+struct qas_cqt_set {
+	double tuning;
+	size_t refcount;	/* protected by "qas_cqt_mutex" */
+	struct qas_cqt_kernel kernel[];
+};
+
+static pthread_mutex_t qas_cqt_mutex;
+static uint8_t qas_cqt_order;
+static struct qas_cqt_set *qas_cqt_current;
+
+static void
+qas_cqt_free(struct qas_cqt_set *ps)
+{
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+
+	for (size_t x = 0; x != table_size; x++) {
+		free(ps->kernel[x].real);
+		free(ps->kernel[x].imag);
+	}
+	free(ps);
+}
+
+static void
+qas_cqt_release(struct qas_cqt_set *ps)
+{
+	size_t refcount;
+
+	pthread_mutex_lock(&qas_cqt_mutex);
+	refcount = --(ps->refcount);
+	pthread_mutex_unlock(&qas_cqt_mutex);
+
+	if (refcount == 0)
+		qas_cqt_free(ps);
+}
+
+/*
+ * Compute the spectral kernels for the given tuning. The temporal
+ * kernel of each band is a Hann windowed complex exponential, which
+ * is aligned to the newest sample of the frame. The returned set has
+ * one reference, owned by the caller.
+ */
+static struct qas_cqt_set *
+qas_cqt_build(double tuning)
+{
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+	const size_t max = 1UL << qas_cqt_order;
+	const double q = 1.0 / (pow(2.0, 1.0 / 12.0) - 1.0);
+	const size_t size = sizeof(struct qas_cqt_set) +
+	    sizeof(struct qas_cqt_kernel) * table_size;
+	struct qas_cqt_set *ps;
+	double *real;
+	double *imag;
+
+	ps = (struct qas_cqt_set *)malloc(size);
+	real = (double *)malloc(sizeof(double) * 2 * max);
+	if (ps == 0 || real == 0) {
+		free(ps);
+		free(real);
+		return (0);
+	}
+	imag = real + max;
+
+	memset(ps, 0, size);
+	ps->tuning = tuning;
+	ps->refcount = 1;
+
+	for (size_t x = 0; x != table_size; x++) {
+		struct qas_cqt_kernel *pk = ps->kernel + x;
+		const double freq = tuning * qas_freq_table[x * QAS_WAVE_STEP];
+		size_t length = q * (double)qas_sample_rate / freq;
+		double limit;
+		double sum;
+		size_t y, z;
+
+		if (length > max)
+			length = max;
+		else if (length < 2)
+			length = 2;
+
+		memset(real, 0, sizeof(double) * max);
+		memset(imag, 0, sizeof(double) * max);
+
+		sum = 0.0;
+		for (y = 0; y != length; y++)
+			sum += 0.5 - 0.5 * cos(2.0 * M_PI * ((double)y + 0.5) / (double)length);
+
+		for (y = 0; y != length; y++) {
+			const double w = (0.5 - 0.5 *
+			    cos(2.0 * M_PI * ((double)y + 0.5) / (double)length)) / sum;
+			const double phase = 2.0 * M_PI * freq * (double)y / (double)qas_sample_rate;
+
+			real[max - length + y] = w * cos(phase);
+			imag[max - length + y] = w * sin(phase);
+		}
+
+		qas_fft_forward(real, imag, qas_cqt_order);
+
+		/* only keep the significant part of the spectral kernel */
+		limit = 0.0;
+		for (y = 0; y != max; y++) {
+			const double value = real[y] * real[y] +
+			    imag[y] * imag[y];
+			if (value > limit)
+				limit = value;
+		}
+		limit *= QAS_CQT_THRESHOLD * QAS_CQT_THRESHOLD;
+
+		for (y = 0; y != max; y++) {
+			if (real[y] * real[y] +
+			    imag[y] * imag[y] >= limit)
+				break;
+		}
+		for (z = max; z-- != y; ) {
+			if (real[z] * real[z] +
+			    imag[z] * imag[z] >= limit)
+				break;
+		}
+
+		pk->offset = y;
+		pk->count = z + 1 - y;
+		pk->real = (double *)malloc(sizeof(double) * pk->count);
+		pk->imag = (double *)malloc(sizeof(double) * pk->count);
+		if (pk->real == 0 || pk->imag == 0) {
+			free(real);
+			qas_cqt_free(ps);
+			return (0);
+		}
+
+		/* store the complex conjugate, scaled by the FFT size */
+		for (size_t t = 0; t != pk->count; t++) {
+			pk->real[t] = real[y + t] / (double)max;
+			pk->imag[t] = -imag[y + t] / (double)max;
+		}
+	}
+	free(real);
+	return (ps);
+}
+
+/*
+ * Returns a reference to the current set of kernels, if any.
+ */
+static struct qas_cqt_set *
+qas_cqt_acquire()
+{
+	struct qas_cqt_set *ps;
+
+	pthread_mutex_lock(&qas_cqt_mutex);
+	ps = qas_cqt_current;
+	if (ps != 0)
+		ps->refcount++;
+	pthread_mutex_unlock(&qas_cqt_mutex);
+
+	return (ps);
+}
+
+/*
+ * Build the kernels for the current tuning, if changed, and publish
+ * them in place of the old set. The set is built without holding
+ * the mutex, so that the workers can keep using the old set.
+ */
+void
+qas_cqt_retune()
+{
+	const double tuning = qas_tuning;
+	struct qas_cqt_set *ps;
+	struct qas_cqt_set *prev;
+
+	pthread_mutex_lock(&qas_cqt_mutex);
+	ps = qas_cqt_current;
+	pthread_mutex_unlock(&qas_cqt_mutex);
+
+	if (ps != 0 && ps->tuning == tuning)
+		return;
+
+	ps = qas_cqt_build(tuning);
+	if (ps == 0)
+		return;
+
+	pthread_mutex_lock(&qas_cqt_mutex);
+	prev = qas_cqt_current;
+	qas_cqt_current = ps;
+	pthread_mutex_unlock(&qas_cqt_mutex);
+
+	/* drop the reference of the old set */
+	if (prev != 0)
+		qas_cqt_release(prev);
+}
+
+/*
+ * FFT scratch space of each thread. It only grows, and is kept for
+ * the lifetime of the thread.
+ */
+static thread_local double *qas_cqt_scratch;
+static thread_local size_t qas_cqt_scratch_size;
+
+static double *
+qas_cqt_scratch_get(size_t size)
+{
+	if (qas_cqt_scratch_size < size) {
+		double *ptr = (double *)realloc(qas_cqt_scratch, sizeof(double) * size);
+
+		if (ptr == 0)
+			return (0);
+		qas_cqt_scratch = ptr;
+		qas_cqt_scratch_size = size;
+	}
+	return (qas_cqt_scratch);
+}
+
+/*
+ * Compute the amplitude of all bands of the given frame.
+ */
+void
+qas_cqt_analyze(struct qas_corr_data *pdata)
+{
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+	const size_t max = 1UL << qas_cqt_order;
+	struct qas_cqt_set *ps;
+	double *fft_real;
+	double *fft_imag;
+
+	fft_real = qas_cqt_scratch_get(2 * max);
+	if (fft_real == 0)
+		return;
+	fft_imag = fft_real + max;
+
+	memcpy(fft_real, pdata->monitor_data + qas_window_size - max,
+	    sizeof(double) * max);
+	memset(fft_imag, 0, sizeof(double) * max);
+
+	qas_fft_forward(fft_real, fft_imag, qas_cqt_order);
+
+	ps = qas_cqt_acquire();
+	if (ps == 0)
+		return;
+
+	for (size_t x = 0; x != table_size; x++) {
+		const struct qas_cqt_kernel *pk = ps->kernel + x;
+		const double *real = fft_real + pk->offset;
+		const double *imag = fft_imag + pk->offset;
+		double sum_real = 0.0;
+		double sum_imag = 0.0;
+
+		for (size_t y = 0; y != pk->count; y++) {
+			sum_real += real[y] * pk->real[y] - imag[y] * pk->imag[y];
+			sum_imag += real[y] * pk->imag[y] + imag[y] * pk->real[y];
+		}
+
+		pdata->band_data[x] = 2.0 * sqrt(sum_real * sum_real + sum_imag * sum_imag);
+		if (pdata->band_data[x] < 1.0)
+			pdata->band_data[x] = 1.0;
+	}
+	qas_cqt_release(ps);
+}
+
+void
+qas_cqt_init()
+{
+	pthread_mutex_init(&qas_cqt_mutex, 0);
+
+	/* use the largest FFT which fits the window */
+	qas_cqt_order = QAS_FFT_ORDER_MAX;
+	while ((1UL << qas_cqt_order) > qas_window_size)
+		qas_cqt_order--;
+
+	qas_cqt_current = 0;
+	qas_cqt_retune();
+}
@@ -25,6 +25,9 @@
 
 #include "qaudiosonar.h"
 
+#define	QAS_DISPLAY_PEAKS_MAX 8
+#define	QAS_DISPLAY_BUDGET 0.5	/* fraction of the frame time */
+
 static pthread_cond_t qas_display_cond;
 static pthread_mutex_t qas_display_mutex;
 
@@ -35,6 +38,9 @@ double *qas_display_data;
 double *qas_display_band;
 size_t qas_display_hist_max;
 uint8_t *qas_iso_table;
+int qas_tuner;
+
+static ssize_t qas_tuner_band = -1;
 
 void
 qas_display_job_insert(struct qas_wave_job *pjob)
@@ -132,11 +138,179 @@ qas_display_worker_done(double *data, double *band)
 	}
 }
 
+/*
+ * Returns the number of peaks to refine in the 2nd scan. This is
+ * limited by the measured cost of a refinement compared to the time
+ * between frames, and is reduced when the display is lagging behind.
+ */
+static size_t
+qas_display_max_peaks()
+{
+	const double period = (double)QAS_CORR_SIZE / (double)qas_sample_rate;
+	const double cost = 3.0 * qas_wave_refine_cost();
+	const size_t lag = qas_display_lag();
+	const size_t lag_limit = 2 * qas_num_workers;
+	size_t retval;
+
+	if (cost * QAS_DISPLAY_PEAKS_MAX <= period * qas_num_workers * QAS_DISPLAY_BUDGET)
+		retval = QAS_DISPLAY_PEAKS_MAX;
+	else
+		retval = (period * qas_num_workers * QAS_DISPLAY_BUDGET) / cost;
+
+	/* shed refinements when lagging */
+	if (lag > lag_limit)
+		retval = 1;
+	else if (lag > lag_limit / 2)
+		retval /= 2;
+
+	if (retval < 1)
+		retval = 1;
+	return (retval);
+}
+
+/*
+ * Set the tuner band. Returns non-zero when the tuner locked or
+ * unlocked. The incremental sums are not fed while the tuner is
+ * locked, so they must then be reset by the caller.
+ */
+static int
+qas_display_tuner_set(ssize_t band)
+{
+	int changed;
+
+	changed = ((qas_tuner_band > 0) != (band > 0));
+	qas_tuner_band = band;
+
+	return (changed && qas_wave_incremental);
+}
+
+/*
+ * Lock the tuner to the strongest band of a completed frame, or
+ * unlock it when there is no signal above the sensitivity level.
+ */
+static void
+qas_display_tuner_update(const double *data, size_t table_size)
+{
+	const double level = 1U << qas_sensitivity;
+	ssize_t band;
+	size_t z = 0;
+	int reset;
+
+	for (size_t x = 0; x != table_size; x++) {
+		if (data[3 * x] > data[3 * z])
+			z = x;
+	}
+
+	if (data[3 * z] < level) {
+		band = -1;
+	} else {
+		band = ((size_t)data[3 * z + 2] + (QAS_WAVE_STEP / 2)) / QAS_WAVE_STEP;
+		if (band < 1)
+			band = 1;
+		else if (band > (ssize_t)table_size - 2)
+			band = table_size - 2;
+	}
+
+	atomic_lock();
+	reset = qas_display_tuner_set(qas_tuner ? band : -1);
+	atomic_unlock();
+
+	if (reset)
+		qas_wave_reset();
+}
+
+/*
+ * Returns the band the tuner is locked to, or -1 if not locked.
+ */
+ssize_t
+qas_display_tuner_band()
+{
+	ssize_t retval;
+	int reset = 0;
+
+	atomic_lock();
+	if (qas_tuner == 0)
+		reset = qas_display_tuner_set(-1);
+	retval = qas_tuner_band;
+	atomic_unlock();
+
+	if (reset)
+		qas_wave_reset();
+
+	return (retval);
+}
+
+/*
+ * Select the peaks of a frame to refine and submit the 2nd scan jobs.
+ */
+static void
+qas_display_schedule(struct qas_corr_data *pcorr)
+{
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+	struct table table[table_size];
+	uint8_t sched[table_size];
+	struct qas_wave_job *pjob;
+	double level;
+	size_t max;
+	size_t y;
+
+	for (size_t x = 0; x != table_size; x++) {
+		table[x].value = pcorr->band_data[x];
+		table[x].band = x;
+	}
+	mergesort(table, table_size, sizeof(table[0]), &qas_table_compare);
+
+	max = qas_display_max_peaks();
+	level = 1U << qas_sensitivity;
+	memset(sched, 0, sizeof(sched));
+
+	/* select the loudest peaks, starting with the maximum */
+	for (size_t x = table_size, z = 0; x-- != 0 && z != max; ) {
+		y = table[x].band;
+
+		/* avoid beginning and end band */
+		if (y == 0)
+			y++;
+		else if (y == table_size - 1)
+			y = table_size - 2;
+
+		if (z != 0) {
+			/* only refine loud local maximums */
+			if (table[x].value < level ||
+			    pcorr->band_data[y] < pcorr->band_data[y - 1] ||
+			    pcorr->band_data[y] < pcorr->band_data[y + 1])
+				continue;
+			/* skip already refined bands */
+			if (sched[y] != 0)
+				continue;
+		}
+		sched[y - 1] = sched[y] = sched[y + 1] = 1;
+		z++;
+	}
+
+	/* keep track of quiet bands */
+	if (qas_wave_sparse)
+		qas_wave_sparse_update(pcorr->band_data, sched, level);
+
+	/* submit new jobs */
+	for (size_t x = 0; x != table_size; x++)
+		pcorr->refcount += sched[x];
+
+	for (size_t x = 0; x != table_size; x++) {
+		if (sched[x] == 0)
+			continue;
+		pjob = qas_wave_job_alloc();
+		pjob->band_start = x * QAS_WAVE_STEP;
+		pjob->band_count = 1;
+		pjob->data = pcorr;
+		qas_wave_job_insert(pjob);
+	}
+}
+
 static void *
 qas_display_worker(void *arg)
 {
 	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
-	struct table table[table_size];
 
 	while (1) {
 		struct qas_wave_job *pjob;
@@ -157,14 +331,15 @@ qas_display_worker(void *arg)
 		atomic_graph_lock();
 		switch (pcorr->state) {
 			size_t off;
-		case QAS_STATE_1ST_SCAN:
 		case QAS_STATE_2ND_SCAN:
-			off = 3 * (pjob->band_start / QAS_WAVE_STEP);
+			for (size_t x = 0; x != pjob->band_count; x++) {
+				off = 3 * (pjob->band_start / QAS_WAVE_STEP + x);
 
-			/* collect a data point */
-			data[off + 0] = pcorr->band_data[pjob->band_start / QAS_WAVE_STEP];
-			data[off + 1] = 0;
-			data[off + 2] = pjob->band_start;
+				/* collect a data point */
+				data[off + 0] = pcorr->band_data[pjob->band_start / QAS_WAVE_STEP + x];
+				data[off + 1] = 0;
+				data[off + 2] = pjob->band_start + x * QAS_WAVE_STEP;
+			}
 			break;
 		}
 		atomic_graph_unlock();
@@ -176,40 +351,27 @@ qas_display_worker(void *arg)
 			continue;
 
 		switch (pcorr->state++) {
-		size_t y;
 		case QAS_STATE_1ST_SCAN:
+			/* collect all data points */
+			atomic_graph_lock();
 			for (size_t x = 0; x != table_size; x++) {
-				table[x].value = pcorr->band_data[x];
-				table[x].band = x;
+				data[3 * x + 0] = pcorr->band_data[x];
+				data[3 * x + 1] = 0;
+				data[3 * x + 2] = x * QAS_WAVE_STEP;
 			}
-			mergesort(table, table_size, sizeof(table[0]), &qas_table_compare);
-
-			y = table[table_size - 1].band;
-
-			/* avoid beginning and end band */
-			if (y == 0)
-				y++;
-			else if (y == table_size - 1)
-				y = table_size - 2;
-
-			/* submit three new jobs */
-			pcorr->refcount += 3;
-
-			pjob = qas_wave_job_alloc();
-			pjob->band_start = y * QAS_WAVE_STEP;
-			pjob->data = pcorr;
-			qas_wave_job_insert(pjob);
-
-			pjob = qas_wave_job_alloc();
-			pjob->band_start = (y - 1) * QAS_WAVE_STEP;
-			pjob->data = pcorr;
-			qas_wave_job_insert(pjob);
+			if (pcorr->pitch_band != 0)
+				data[3 * (pcorr->pitch_band / QAS_WAVE_STEP) + 2] = pcorr->pitch_band;
+			atomic_graph_unlock();
 
-			pjob = qas_wave_job_alloc();
-			pjob->band_start = (y + 1) * QAS_WAVE_STEP;
-			pjob->data = pcorr;
-			qas_wave_job_insert(pjob);
-			break;
+			/* only the scanning engines need a 2nd scan */
+			if (pcorr->dropped == 0 &&
+			    (pcorr->engine == QAS_ENGINE_TRIANGLE ||
+			     pcorr->engine == QAS_ENGINE_GOERTZEL)) {
+				qas_display_schedule(pcorr);
+				break;
+			}
+			pcorr->state++;
+			/* FALLTHROUGH */
 
 		case QAS_STATE_2ND_SCAN:
 			data_old = qas_display_get_line(pcorr->sequence_number - 1);
@@ -220,6 +382,9 @@ qas_display_worker(void *arg)
 			}
 			atomic_graph_unlock();
 
+			if (qas_tuner && pcorr->dropped == 0)
+				qas_display_tuner_update(data, table_size);
+
 			qas_display_worker_done(data, band);
 			qas_corr_free(pcorr);
 
@@ -0,0 +1,114 @@
+/*-
+ * Copyright (c) 2022 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "qaudiosonar.h"
+
+static double *qas_fft_cos;
+static double *qas_fft_sin;
+
+/*
+ * In-place radix-2 complex FFT of (1 << order) points, where order
+ * must not exceed QAS_FFT_ORDER_MAX.
+ */
+void
+qas_fft_forward(double *real, double *imag, uint8_t order)
+{
+	const size_t max = 1UL << order;
+
+	/* bit reverse the input */
+	for (size_t x = 0, y = 0; x != max; x++) {
+		size_t m;
+
+		if (x < y) {
+			double temp;
+
+			temp = real[x];
+			real[x] = real[y];
+			real[y] = temp;
+
+			temp = imag[x];
+			imag[x] = imag[y];
+			imag[y] = temp;
+		}
+
+		for (m = max / 2; m != 0 && (y & m) != 0; m /= 2)
+			y ^= m;
+		y |= m;
+	}
+
+	for (size_t half = 1; half != max; half *= 2) {
+		const size_t stride = (1UL << QAS_FFT_ORDER_MAX) / (2 * half);
+
+		for (size_t x = 0; x != max; x += 2 * half) {
+			for (size_t y = 0; y != half; y++) {
+				const double wr = qas_fft_cos[y * stride];
+				const double wi = qas_fft_sin[y * stride];
+				const size_t a = x + y;
+				const size_t b = x + y + half;
+				const double tr = real[b] * wr - imag[b] * wi;
+				const double ti = real[b] * wi + imag[b] * wr;
+
+				real[b] = real[a] - tr;
+				imag[b] = imag[a] - ti;
+				real[a] += tr;
+				imag[a] += ti;
+			}
+		}
+	}
+}
+
+/*
+ * In-place inverse of qas_fft_forward(), including the scaling.
+ */
+void
+qas_fft_inverse(double *real, double *imag, uint8_t order)
+{
+	const size_t max = 1UL << order;
+	const double scale = 1.0 / (double)max;
+
+	for (size_t x = 0; x != max; x++)
+		imag[x] = -imag[x];
+
+	qas_fft_forward(real, imag, order);
+
+	for (size_t x = 0; x != max; x++) {
+		real[x] *= scale;
+		imag[x] *= -scale;
+	}
+}
+
+void
+qas_fft_init()
+{
+	const size_t max = 1UL << QAS_FFT_ORDER_MAX;
+
+	qas_fft_cos = (double *)malloc(sizeof(double) * (max / 2));
+	qas_fft_sin = (double *)malloc(sizeof(double) * (max / 2));
+
+	for (size_t x = 0; x != max / 2; x++) {
+		qas_fft_cos[x] = cos(2.0 * M_PI * (double)x / (double)max);
+		qas_fft_sin[x] = -sin(2.0 * M_PI * (double)x / (double)max);
+	}
+}
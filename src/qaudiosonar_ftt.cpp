@@ -65,3 +65,380 @@ qas_ftt_sin(double x)
 {
 	return (qas_ftt_cos(x + 0.75));
 }
+
+int qas_ftt_fixed;
+
+/*
+ * Returns a triangular wave function based on the fixed point phase
+ * "x", where 2**32 is one period. The result is "|4 * x - 2| - 1"
+ * computed without branches, and is identical to qas_ftt_cos() for
+ * the same phase.
+ */
+double
+qas_ftt_cos_fixed(uint32_t x)
+{
+	const int32_t y = (int32_t)(x + 0x80000000U);
+	const uint32_t m = (uint32_t)(y >> 31);
+
+	return ((double)(((uint32_t)y ^ m) - m) * (1.0 / 1073741824.0) - 1.0);
+}
+
+/*
+ * Returns a triangular wave function based on the fixed point phase "x".
+ */
+double
+qas_ftt_sin_fixed(uint32_t x)
+{
+	return (qas_ftt_cos_fixed(x + 0xC0000000U));
+}
+
+/*
+ * Convert a phase in periods into a fixed point phase. When used as
+ * a phase increment, the frequency error is at most 2**-33 periods
+ * per sample. After "n" samples the triangle differs from the double
+ * precision version by at most "4 * n * 2**-33".
+ */
+uint32_t
+qas_ftt_fixed_phase(double x)
+{
+	x -= floor(x);
+	return ((uint32_t)(uint64_t)(x * 4294967296.0 + 0.5));
+}
+
+/*
+ * Multi-band triangular wave correlator.
+ *
+ * Each lane of the vector holds one band. The phase is kept in the
+ * range [0, 1) by a branch-free compare and subtract, and the
+ * triangle is computed as "|4 * phase - 2| - 1", which is equivalent
+ * to qas_ftt_cos(). The sine is the same triangle shifted by 0.75.
+ */
+template <size_t N>
+static inline __attribute__((always_inline)) void
+qas_ftt_multi_sub(const double *indata, size_t num, double *phase,
+    const double *delta_phase, double *cos_out, double *sin_out)
+{
+	typedef double vec_t __attribute__((vector_size(N * sizeof(double))));
+	typedef int64_t ivec_t __attribute__((vector_size(N * sizeof(double))));
+
+	const vec_t one = (vec_t){} + 1.0;
+	vec_t ph;
+	vec_t dp;
+	vec_t cos_in = {};
+	vec_t sin_in = {};
+
+	memcpy(&ph, phase, sizeof(ph));
+	memcpy(&dp, delta_phase, sizeof(dp));
+
+	for (size_t x = 0; x != num; x++) {
+		vec_t c;
+		vec_t s;
+
+		c = ph * 4.0 - 2.0;
+		c = (vec_t)((ivec_t)c & 0x7FFFFFFFFFFFFFFFLL) - 1.0;
+
+		s = ph + 0.75;
+		s -= (vec_t)((ivec_t)(s >= one) & (ivec_t)one);
+		s = s * 4.0 - 2.0;
+		s = (vec_t)((ivec_t)s & 0x7FFFFFFFFFFFFFFFLL) - 1.0;
+
+		cos_in += c * indata[x];
+		sin_in += s * indata[x];
+
+		ph += dp;
+		ph -= (vec_t)((ivec_t)(ph >= one) & (ivec_t)one);
+	}
+
+	memcpy(phase, &ph, sizeof(ph));
+	memcpy(cos_out, &cos_in, sizeof(cos_in));
+	memcpy(sin_out, &sin_in, sizeof(sin_in));
+}
+
+/*
+ * Same as above, except using a 32-bit fixed point phase accumulator,
+ * which is exactly periodic and needs no range reduction.
+ */
+template <size_t N>
+static inline __attribute__((always_inline)) void
+qas_ftt_multi_fixed_sub(const double *indata, size_t num, uint32_t *phase,
+    const uint32_t *delta_phase, double *cos_out, double *sin_out)
+{
+	typedef double vec_t __attribute__((vector_size(N * sizeof(double))));
+	typedef int64_t ivec_t __attribute__((vector_size(N * sizeof(double))));
+
+	int64_t temp[N];
+	ivec_t ph;
+	ivec_t dp;
+	vec_t cos_in = {};
+	vec_t sin_in = {};
+
+	for (size_t x = 0; x != N; x++)
+		temp[x] = phase[x];
+	memcpy(&ph, temp, sizeof(ph));
+
+	for (size_t x = 0; x != N; x++)
+		temp[x] = delta_phase[x];
+	memcpy(&dp, temp, sizeof(dp));
+
+	for (size_t x = 0; x != num; x++) {
+		ivec_t c;
+		ivec_t s;
+		ivec_t m;
+
+		/* compute "|phase - 2**31|" */
+		c = ph - 0x80000000LL;
+		m = c >> 63;
+		c = (c ^ m) - m;
+
+		s = ((ph + 0xC0000000LL) & 0xFFFFFFFFLL) - 0x80000000LL;
+		m = s >> 63;
+		s = (s ^ m) - m;
+
+		/* convert to floating point using the 2**52 exponent */
+		cos_in += ((vec_t)(c | 0x4330000000000000LL) - 4503599627370496.0) *
+		    (1.0 / 1073741824.0) * indata[x] - indata[x];
+		sin_in += ((vec_t)(s | 0x4330000000000000LL) - 4503599627370496.0) *
+		    (1.0 / 1073741824.0) * indata[x] - indata[x];
+
+		ph = (ph + dp) & 0xFFFFFFFFLL;
+	}
+
+	memcpy(temp, &ph, sizeof(ph));
+	for (size_t x = 0; x != N; x++)
+		phase[x] = temp[x];
+	memcpy(cos_out, &cos_in, sizeof(cos_in));
+	memcpy(sin_out, &sin_in, sizeof(sin_in));
+}
+
+template <size_t N, bool FIXED>
+static inline __attribute__((always_inline)) void
+qas_ftt_multi_tmpl(const double *indata, size_t num, double *phase,
+    const double *delta_phase, double *cos_out, double *sin_out, size_t bands)
+{
+	for (size_t b = 0; b < bands; b += N) {
+		double ph[N];
+		double dp[N];
+		double c[N];
+		double s[N];
+		size_t n = bands - b;
+
+		if (n > N)
+			n = N;
+
+		for (size_t x = 0; x != N; x++) {
+			if (x < n) {
+				ph[x] = phase[b + x] - floor(phase[b + x]);
+				dp[x] = delta_phase[b + x];
+			} else {
+				ph[x] = 0.0;
+				dp[x] = 0.0;
+			}
+		}
+
+		if (FIXED) {
+			uint32_t fph[N];
+			uint32_t fdp[N];
+
+			for (size_t x = 0; x != N; x++) {
+				fph[x] = qas_ftt_fixed_phase(ph[x]);
+				fdp[x] = qas_ftt_fixed_phase(dp[x]);
+			}
+
+			qas_ftt_multi_fixed_sub<N>(indata, num, fph, fdp, c, s);
+
+			for (size_t x = 0; x != N; x++)
+				ph[x] = (double)fph[x] * (1.0 / 4294967296.0);
+		} else {
+			qas_ftt_multi_sub<N>(indata, num, ph, dp, c, s);
+		}
+
+		for (size_t x = 0; x != n; x++) {
+			phase[b + x] = ph[x];
+			cos_out[b + x] = c[x];
+			sin_out[b + x] = s[x];
+		}
+	}
+}
+
+/*
+ * Multi-band Goertzel filter.
+ *
+ * Each lane of the vector holds one band. The filter state is kept
+ * in "s1" and "s2", so that the input can be processed in pieces.
+ */
+template <size_t N>
+static inline __attribute__((always_inline)) void
+qas_ftt_goertzel_sub(const double *indata, size_t num, const double *coeff,
+    double *s1, double *s2)
+{
+	typedef double vec_t __attribute__((vector_size(N * sizeof(double))));
+
+	vec_t c;
+	vec_t a;
+	vec_t b;
+
+	memcpy(&c, coeff, sizeof(c));
+	memcpy(&a, s1, sizeof(a));
+	memcpy(&b, s2, sizeof(b));
+
+	for (size_t x = 0; x != num; x++) {
+		const vec_t t = c * a - b + indata[x];
+
+		b = a;
+		a = t;
+	}
+
+	memcpy(s1, &a, sizeof(a));
+	memcpy(s2, &b, sizeof(b));
+}
+
+template <size_t N>
+static inline __attribute__((always_inline)) void
+qas_ftt_goertzel_tmpl(const double *indata, size_t num, const double *coeff,
+    double *s1, double *s2, size_t bands)
+{
+	for (size_t b = 0; b < bands; b += N) {
+		double c[N];
+		double a[N];
+		double d[N];
+		size_t n = bands - b;
+
+		if (n > N)
+			n = N;
+
+		for (size_t x = 0; x != N; x++) {
+			if (x < n) {
+				c[x] = coeff[b + x];
+				a[x] = s1[b + x];
+				d[x] = s2[b + x];
+			} else {
+				c[x] = 0.0;
+				a[x] = 0.0;
+				d[x] = 0.0;
+			}
+		}
+
+		qas_ftt_goertzel_sub<N>(indata, num, c, a, d);
+
+		for (size_t x = 0; x != n; x++) {
+			s1[b + x] = a[x];
+			s2[b + x] = d[x];
+		}
+	}
+}
+
+typedef void (qas_ftt_multi_t)(const double *, size_t, double *,
+    const double *, double *, double *, size_t);
+typedef void (qas_ftt_goertzel_t)(const double *, size_t, const double *,
+    double *, double *, size_t);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("avx512f"))) static void
+qas_ftt_multi_avx512(const double *indata, size_t num, double *phase,
+    const double *delta_phase, double *cos_out, double *sin_out, size_t bands)
+{
+	if (qas_ftt_fixed)
+		qas_ftt_multi_tmpl<16, true>(indata, num, phase, delta_phase, cos_out, sin_out, bands);
+	else
+		qas_ftt_multi_tmpl<16, false>(indata, num, phase, delta_phase, cos_out, sin_out, bands);
+}
+
+__attribute__((target("avx2"))) static void
+qas_ftt_multi_avx2(const double *indata, size_t num, double *phase,
+    const double *delta_phase, double *cos_out, double *sin_out, size_t bands)
+{
+	if (qas_ftt_fixed)
+		qas_ftt_multi_tmpl<8, true>(indata, num, phase, delta_phase, cos_out, sin_out, bands);
+	else
+		qas_ftt_multi_tmpl<8, false>(indata, num, phase, delta_phase, cos_out, sin_out, bands);
+}
+
+__attribute__((target("avx512f"))) static void
+qas_ftt_goertzel_avx512(const double *indata, size_t num, const double *coeff,
+    double *s1, double *s2, size_t bands)
+{
+	qas_ftt_goertzel_tmpl<16>(indata, num, coeff, s1, s2, bands);
+}
+
+__attribute__((target("avx2"))) static void
+qas_ftt_goertzel_avx2(const double *indata, size_t num, const double *coeff,
+    double *s1, double *s2, size_t bands)
+{
+	qas_ftt_goertzel_tmpl<8>(indata, num, coeff, s1, s2, bands);
+}
+#endif
+
+static void
+qas_ftt_multi_generic(const double *indata, size_t num, double *phase,
+    const double *delta_phase, double *cos_out, double *sin_out, size_t bands)
+{
+	if (qas_ftt_fixed)
+		qas_ftt_multi_tmpl<4, true>(indata, num, phase, delta_phase, cos_out, sin_out, bands);
+	else
+		qas_ftt_multi_tmpl<4, false>(indata, num, phase, delta_phase, cos_out, sin_out, bands);
+}
+
+static void
+qas_ftt_goertzel_generic(const double *indata, size_t num, const double *coeff,
+    double *s1, double *s2, size_t bands)
+{
+	qas_ftt_goertzel_tmpl<4>(indata, num, coeff, s1, s2, bands);
+}
+
+static qas_ftt_multi_t *qas_ftt_multi_fn = &qas_ftt_multi_generic;
+static qas_ftt_goertzel_t *qas_ftt_goertzel_fn = &qas_ftt_goertzel_generic;
+static size_t qas_ftt_multi_bands = 4;
+
+/*
+ * Correlate "num" input samples against the triangular cosine and
+ * sine of "bands" different frequencies in a single pass over the
+ * input. The phase array is updated to the phase following the last
+ * sample.
+ */
+void
+qas_ftt_multi(const double *indata, size_t num, double *phase,
+    const double *delta_phase, double *cos_out, double *sin_out, size_t bands)
+{
+	qas_ftt_multi_fn(indata, num, phase, delta_phase, cos_out, sin_out, bands);
+}
+
+/*
+ * Run "num" input samples through the Goertzel filters of "bands"
+ * different frequencies in a single pass over the input. The
+ * coefficient of each filter is "2 * cos(w)", where "w" is the
+ * frequency in radians per sample. The filter state in "s1" and "s2"
+ * must be zero before the first call.
+ */
+void
+qas_ftt_goertzel(const double *indata, size_t num, const double *coeff,
+    double *s1, double *s2, size_t bands)
+{
+	qas_ftt_goertzel_fn(indata, num, coeff, s1, s2, bands);
+}
+
+/*
+ * Returns the number of bands processed per pass over the input.
+ */
+size_t
+qas_ftt_multi_width()
+{
+	return (qas_ftt_multi_bands);
+}
+
+void
+qas_ftt_init()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f")) {
+		qas_ftt_multi_fn = &qas_ftt_multi_avx512;
+		qas_ftt_goertzel_fn = &qas_ftt_goertzel_avx512;
+		qas_ftt_multi_bands = 16;
+	} else if (__builtin_cpu_supports("avx2")) {
+		qas_ftt_multi_fn = &qas_ftt_multi_avx2;
+		qas_ftt_goertzel_fn = &qas_ftt_goertzel_avx2;
+		qas_ftt_multi_bands = 8;
+	}
+#endif
+}
@@ -0,0 +1,147 @@
+/*-
+ * Copyright (c) 2022 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Check that the fixed point phase triangle generator matches the
+ * double precision version.
+ *
+ * The basis functions must be identical for the same phase. The
+ * multi-band correlator output must match within the error of the
+ * fixed point phase increment, which is at most 2**-33 periods per
+ * sample. The triangle has a slope of 4, so the basis of sample "x"
+ * differs by at most "4 * (x + 1) * 2**-33", and each band output by
+ * at most the sum of that times "|in[x]|". A small term is added for
+ * the rounding of the sums.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "qaudiosonar.h"
+
+#define	QAS_FTT_TEST_PHASES 10000000
+#define	QAS_FTT_TEST_BANDS 37	/* not a multiple of the vector width */
+#define	QAS_FTT_TEST_SAMPLES 8192
+#define	QAS_FTT_TEST_ROUNDING 1e-12	/* relative to the sum of |in[x]| */
+
+static uint32_t qas_ftt_test_seed = 1;
+
+static uint32_t
+qas_ftt_test_random()
+{
+	/* xorshift32 */
+	qas_ftt_test_seed ^= qas_ftt_test_seed << 13;
+	qas_ftt_test_seed ^= qas_ftt_test_seed >> 17;
+	qas_ftt_test_seed ^= qas_ftt_test_seed << 5;
+	return (qas_ftt_test_seed);
+}
+
+static int
+qas_ftt_test_basis()
+{
+	for (size_t x = 0; x != QAS_FTT_TEST_PHASES; x++) {
+		const uint32_t ph = qas_ftt_test_random();
+		const double fph = (double)ph / 4294967296.0;
+
+		if (qas_ftt_cos_fixed(ph) != qas_ftt_cos(fph) ||
+		    qas_ftt_sin_fixed(ph) != qas_ftt_sin(fph)) {
+			printf("FAIL basis: phase 0x%08x\n", ph);
+			return (1);
+		}
+	}
+	printf("OK basis: %d phases identical\n", QAS_FTT_TEST_PHASES);
+	return (0);
+}
+
+static int
+qas_ftt_test_multi()
+{
+	const size_t bands = QAS_FTT_TEST_BANDS;
+	const size_t num = QAS_FTT_TEST_SAMPLES;
+	double *in = (double *)malloc(sizeof(double) * num);
+	double phase[2][bands];
+	double delta[bands];
+	double c[2][bands];
+	double s[2][bands];
+	double limit = 0;
+	double sum = 0;
+	double worst = 0;
+	int retval = 0;
+
+	for (size_t x = 0; x != num; x++) {
+		in[x] = (double)(int32_t)qas_ftt_test_random() / 2147483648.0;
+		limit += fabs(in[x]) * 4.0 * (double)(x + 1) / 8589934592.0;
+		sum += fabs(in[x]);
+	}
+	limit += sum * QAS_FTT_TEST_ROUNDING;
+
+	for (size_t b = 0; b != bands; b++) {
+		/* the start phase is exact in fixed point */
+		phase[0][b] = phase[1][b] = (double)qas_ftt_test_random() / 4294967296.0;
+		/* the frequency is half a step off, which is the worst case */
+		delta[b] = (double)(qas_ftt_test_random() >> 1) / 4294967296.0;
+		delta[b] += 1.0 / 8589934592.0;
+	}
+
+	for (int fixed = 0; fixed != 2; fixed++) {
+		qas_ftt_fixed = fixed;
+		qas_ftt_multi(in, num, phase[fixed], delta, c[fixed], s[fixed], bands);
+	}
+
+	for (size_t b = 0; b != bands; b++) {
+		const double dc = fabs(c[1][b] - c[0][b]);
+		const double ds = fabs(s[1][b] - s[0][b]);
+
+		if (dc > worst)
+			worst = dc;
+		if (ds > worst)
+			worst = ds;
+		if (dc > limit || ds > limit) {
+			printf("FAIL multi: band %zu differs by %g, limit %g\n",
+			    b, (dc > ds) ? dc : ds, limit);
+			retval = 1;
+		}
+	}
+	if (retval == 0) {
+		printf("OK multi: %zu bands, %zu samples, worst %g (%g relative), limit %g\n",
+		    bands, num, worst, worst / sum, limit);
+	}
+	free(in);
+	return (retval);
+}
+
+int
+main()
+{
+	int retval = 0;
+
+	qas_ftt_init();
+
+	retval |= qas_ftt_test_basis();
+	retval |= qas_ftt_test_multi();
+
+	return (retval);
+}
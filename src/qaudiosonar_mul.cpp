@@ -36,17 +36,39 @@
 #error "QAS_X3_LOG2_COMBA must be greater than 1"
 #endif
 
-struct qas_x3_input_double {
-	double	a;
-	double	b;
+#if (QAS_X3_LOG2_COMBA > QAS_MUL_ORDER)
+#error "QAS_X3_LOG2_COMBA must not be greater than QAS_MUL_ORDER"
+#endif
+
+#define	QAS_X3_COMBA (1UL << QAS_X3_LOG2_COMBA)
+
+int qas_x3_float;
+
+/*
+ * The multiplier computes in double precision, or in single
+ * precision with double precision input and output, see "-x".
+ *
+ * Both versions sum and difference the inputs before multiplying.
+ * The rounding error of an output is therefore bounded by the size
+ * of the inputs, not of the output. For random inputs of size
+ * "max", the largest error is about 2**-52 (double) or 2**-23
+ * (float) times "max * |a|max * |b|max". A bound of 4 times that
+ * holds up to QAS_MUL_SIZE. For 24-bit audio, the float version keeps
+ * about 20 significant bits of the correlation peak.
+ */
+template <typename T>
+struct qas_x3_input {
+	T	a;
+	T	b;
 };
 
 /*
  * <input size> = "stride"
  * <output size> = 2 * "stride"
  */
+template <typename T>
 static void
-qas_x3_multiply_sub_double(struct qas_x3_input_double *input, double *ptr_low, double *ptr_high,
+qas_x3_multiply_sub(struct qas_x3_input<T> *input, T *ptr_low, T *ptr_high,
     const size_t stride, const uint8_t toggle)
 {
 	size_t x;
@@ -59,7 +81,7 @@ qas_x3_multiply_sub_double(struct qas_x3_input_double *input, double *ptr_low, d
 
 			/* inverse step */
 			for (x = 0; x != strideh; x++) {
-				double a, b, c, d;
+				T a, b, c, d;
 
 				a = ptr_low[x];
 				b = ptr_low[x + strideh];
@@ -70,16 +92,16 @@ qas_x3_multiply_sub_double(struct qas_x3_input_double *input, double *ptr_low, d
 				ptr_high[x] = a + b + c + d;
 			}
 
-			qas_x3_multiply_sub_double(input, ptr_low, ptr_low + strideh, strideh, 1);
+			qas_x3_multiply_sub(input, ptr_low, ptr_low + strideh, strideh, 1);
 
 			for (x = 0; x != strideh; x++)
 				ptr_low[x + strideh] = -ptr_low[x + strideh];
 
-			qas_x3_multiply_sub_double(input + strideh, ptr_low + strideh, ptr_high + strideh, strideh, 1);
+			qas_x3_multiply_sub(input + strideh, ptr_low + strideh, ptr_high + strideh, strideh, 1);
 
 			/* forward step */
 			for (x = 0; x != strideh; x++) {
-				double a, b, c, d;
+				T a, b, c, d;
 
 				a = ptr_low[x];
 				b = ptr_low[x + strideh];
@@ -93,13 +115,13 @@ qas_x3_multiply_sub_double(struct qas_x3_input_double *input, double *ptr_low, d
 				input[x + strideh].b += input[x].b;
 			}
 
-			qas_x3_multiply_sub_double(input + strideh, ptr_low + strideh, ptr_high, strideh, 0);
+			qas_x3_multiply_sub(input + strideh, ptr_low + strideh, ptr_high, strideh, 0);
 		} else {
-			qas_x3_multiply_sub_double(input + strideh, ptr_low + strideh, ptr_high, strideh, 1);
+			qas_x3_multiply_sub(input + strideh, ptr_low + strideh, ptr_high, strideh, 1);
 
 			/* inverse step */
 			for (x = 0; x != strideh; x++) {
-				double a, b, c, d;
+				T a, b, c, d;
 
 				a = ptr_low[x];
 				b = ptr_low[x + strideh];
@@ -113,16 +135,16 @@ qas_x3_multiply_sub_double(struct qas_x3_input_double *input, double *ptr_low, d
 				input[x + strideh].b -= input[x].b;
 			}
 
-			qas_x3_multiply_sub_double(input + strideh, ptr_low + strideh, ptr_high + strideh, strideh, 0);
+			qas_x3_multiply_sub(input + strideh, ptr_low + strideh, ptr_high + strideh, strideh, 0);
 
 			for (x = 0; x != strideh; x++)
 				ptr_low[x + strideh] = -ptr_low[x + strideh];
 
-			qas_x3_multiply_sub_double(input, ptr_low, ptr_low + strideh, strideh, 0);
+			qas_x3_multiply_sub(input, ptr_low, ptr_low + strideh, strideh, 0);
 
 			/* forward step */
 			for (x = 0; x != strideh; x++) {
-				double a, b, c, d;
+				T a, b, c, d;
 
 				a = ptr_low[x];
 				b = ptr_low[x + strideh];
@@ -135,7 +157,7 @@ qas_x3_multiply_sub_double(struct qas_x3_input_double *input, double *ptr_low, d
 		}
 	} else {
 		for (x = 0; x != stride; x++) {
-			double value = input[x].a;
+			T value = input[x].a;
 
 			for (y = 0; y != (stride - x); y++) {
 				ptr_low[x + y] += input[y].b * value;
@@ -149,25 +171,536 @@ qas_x3_multiply_sub_double(struct qas_x3_input_double *input, double *ptr_low, d
 }
 
 /*
- * <input size> = "max"
- * <output size> = 2 * "max"
+ * Vectorized Comba base case, with "N" lanes per vector. All the
+ * output columns are accumulated in vector registers, and "b" is
+ * zero padded on both sides, so that every column can be updated
+ * for every element of "a", without any branches. The products are
+ * summed in a different order than in the generic base case, so the
+ * floating point results differ in the last bits.
  */
-void
-qas_x3_multiply_double(double *va, double *vb, double *pc, const size_t max)
+template <typename T, size_t N>
+static inline __attribute__((always_inline)) void
+qas_x3_comba_tmpl(const T *a, const T *b, T *ptr_low, T *ptr_high)
 {
-	struct qas_x3_input_double input[max];
-	size_t x;
+	typedef T vec_t __attribute__((vector_size(N * sizeof(T))));
+
+	T pad[3 * QAS_X3_COMBA] __attribute__((aligned(64)));
+	vec_t sum[(2 * QAS_X3_COMBA) / N] = {};
+
+	memset(pad, 0, sizeof(pad[0]) * QAS_X3_COMBA);
+	memcpy(pad + QAS_X3_COMBA, b, sizeof(pad[0]) * QAS_X3_COMBA);
+	memset(pad + 2 * QAS_X3_COMBA, 0, sizeof(pad[0]) * QAS_X3_COMBA);
+
+	for (size_t x = 0; x != QAS_X3_COMBA; x++) {
+		const T *pb = pad + QAS_X3_COMBA - x;
+		const T value = a[x];
+
+		for (size_t y = 0; y != (2 * QAS_X3_COMBA) / N; y++) {
+			vec_t t;
+
+			memcpy(&t, pb + y * N, sizeof(t));
+			sum[y] += t * value;
+		}
+	}
+
+	for (size_t y = 0; y != QAS_X3_COMBA / N; y++) {
+		vec_t t;
+
+		memcpy(&t, ptr_low + y * N, sizeof(t));
+		t += sum[y];
+		memcpy(ptr_low + y * N, &t, sizeof(t));
+
+		memcpy(&t, ptr_high + y * N, sizeof(t));
+		t += sum[y + QAS_X3_COMBA / N];
+		memcpy(ptr_high + y * N, &t, sizeof(t));
+	}
+}
+
+#define	QAS_X3_LANES(n) ((n) < QAS_X3_COMBA ? (n) : QAS_X3_COMBA)
+
+/* the vectorized base case, selected by qas_x3_init() */
+template <typename T>
+struct qas_x3_comba {
+	static void (*fn)(const T *, const T *, T *, T *);
+};
+
+template <typename T>
+void (*qas_x3_comba<T>::fn)(const T *, const T *, T *, T *);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("avx512f"))) static void
+qas_x3_comba_double_avx512(const double *a, const double *b, double *ptr_low, double *ptr_high)
+{
+	qas_x3_comba_tmpl<double, QAS_X3_LANES(8)>(a, b, ptr_low, ptr_high);
+}
+
+__attribute__((target("avx2,fma"))) static void
+qas_x3_comba_double_avx2(const double *a, const double *b, double *ptr_low, double *ptr_high)
+{
+	qas_x3_comba_tmpl<double, QAS_X3_LANES(4)>(a, b, ptr_low, ptr_high);
+}
+
+__attribute__((target("avx512f"))) static void
+qas_x3_comba_float_avx512(const float *a, const float *b, float *ptr_low, float *ptr_high)
+{
+	qas_x3_comba_tmpl<float, QAS_X3_LANES(16)>(a, b, ptr_low, ptr_high);
+}
+
+__attribute__((target("avx2,fma"))) static void
+qas_x3_comba_float_avx2(const float *a, const float *b, float *ptr_low, float *ptr_high)
+{
+	qas_x3_comba_tmpl<float, QAS_X3_LANES(8)>(a, b, ptr_low, ptr_high);
+}
+#endif
+
+static void
+qas_x3_comba_double_generic(const double *a, const double *b, double *ptr_low, double *ptr_high)
+{
+	qas_x3_comba_tmpl<double, QAS_X3_LANES(4)>(a, b, ptr_low, ptr_high);
+}
+
+static void
+qas_x3_comba_float_generic(const float *a, const float *b, float *ptr_low, float *ptr_high)
+{
+	qas_x3_comba_tmpl<float, QAS_X3_LANES(4)>(a, b, ptr_low, ptr_high);
+}
+
+/*
+ * Same as qas_x3_multiply_sub(), but for a stride known at compile
+ * time and with the two inputs in separate arrays.
+ */
+template <typename T, size_t S>
+struct qas_x3_fixed {
+	static void
+	multiply(T *a, T *b, T *ptr_low, T *ptr_high, const uint8_t toggle)
+	{
+		const size_t strideh = S / 2;
+		size_t x;
+
+		if (toggle) {
+
+			/* inverse step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = t0 + t1;
+				ptr_high[x] = t0 + t1 + t2 + t3;
+			}
 
+			qas_x3_fixed<T, S / 2>::multiply(a, b, ptr_low, ptr_low + strideh, 1);
+
+			for (x = 0; x != strideh; x++)
+				ptr_low[x + strideh] = -ptr_low[x + strideh];
+
+			qas_x3_fixed<T, S / 2>::multiply(a + strideh, b + strideh, ptr_low + strideh, ptr_high + strideh, 1);
+
+			/* forward step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = -t0 - t1;
+				ptr_high[x] = t2 + t1 - t3;
+
+				a[x + strideh] += a[x];
+				b[x + strideh] += b[x];
+			}
+
+			qas_x3_fixed<T, S / 2>::multiply(a + strideh, b + strideh, ptr_low + strideh, ptr_high, 0);
+		} else {
+			qas_x3_fixed<T, S / 2>::multiply(a + strideh, b + strideh, ptr_low + strideh, ptr_high, 1);
+
+			/* inverse step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = -t0 - t1;
+				ptr_high[x] = t0 + t1 + t2 + t3;
+
+				a[x + strideh] -= a[x];
+				b[x + strideh] -= b[x];
+			}
+
+			qas_x3_fixed<T, S / 2>::multiply(a + strideh, b + strideh, ptr_low + strideh, ptr_high + strideh, 0);
+
+			for (x = 0; x != strideh; x++)
+				ptr_low[x + strideh] = -ptr_low[x + strideh];
+
+			qas_x3_fixed<T, S / 2>::multiply(a, b, ptr_low, ptr_low + strideh, 0);
+
+			/* forward step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = t1 - t0;
+				ptr_high[x] = t2 - t1 - t3;
+			}
+		}
+	}
+};
+
+template <typename T>
+struct qas_x3_fixed<T, QAS_X3_COMBA> {
+	static void
+	multiply(T *a, T *b, T *ptr_low, T *ptr_high, const uint8_t)
+	{
+		qas_x3_comba<T>::fn(a, b, ptr_low, ptr_high);
+	}
+};
+
+template <typename T, size_t S>
+static void
+qas_x3_multiply_fixed(const T *va, const T *vb, T *pc)
+{
+	T a[S] __attribute__((aligned(64)));
+	T b[S] __attribute__((aligned(64)));
+
+	memcpy(a, va, sizeof(a));
+	memcpy(b, vb, sizeof(b));
+
+	qas_x3_fixed<T, S>::multiply(a, b, pc, pc + S, 1);
+}
+
+/*
+ * Select the specialized version for sizes from QAS_X3_COMBA to "S".
+ */
+template <typename T, size_t S>
+struct qas_x3_dispatch {
+	static bool
+	multiply(const T *va, const T *vb, T *pc, const size_t max)
+	{
+		if (max != S)
+			return (qas_x3_dispatch<T, S / 2>::multiply(va, vb, pc, max));
+		qas_x3_multiply_fixed<T, S>(va, vb, pc);
+		return (true);
+	}
+};
+
+template <typename T>
+struct qas_x3_dispatch<T, QAS_X3_COMBA / 2> {
+	static bool
+	multiply(const T *, const T *, T *, const size_t)
+	{
+		return (false);
+	}
+};
+
+template <typename T>
+static void
+qas_x3_multiply(const T *va, const T *vb, T *pc, const size_t max)
+{
 	/* check for non-power of two */
 	if (max & (max - 1))
 		return;
 
+	/* use the specialized versions, if any */
+	if (qas_x3_comba<T>::fn != 0 &&
+	    qas_x3_dispatch<T, QAS_MUL_SIZE>::multiply(va, vb, pc, max))
+		return;
+
+	struct qas_x3_input<T> input[max];
+
 	/* setup input vector */
-	for (x = 0; x != max; x++) {
+	for (size_t x = 0; x != max; x++) {
 		input[x].a = va[x];
 		input[x].b = vb[x];
 	}
 
 	/* do multiplication */
-	qas_x3_multiply_sub_double(input, pc, pc + max, max, 1);
+	qas_x3_multiply_sub(input, pc, pc + max, max, 1);
+}
+
+/*
+ * The sums and differences of the "b" input depend only on "b".
+ * When "b" is multiplied by many "a" inputs, the "b" values seen by
+ * each base case are computed once into a plan, in the order the
+ * recursion visits the base cases, and the recursion then only
+ * transforms "a".
+ */
+template <typename T, size_t S>
+struct qas_x3_planned {
+	/* number of "b" values stored for each base case, times 3 per level */
+	static const size_t plan_size = 3 * qas_x3_planned<T, S / 2>::plan_size;
+
+	static void
+	prepare(T *b, T *&plan, const uint8_t toggle)
+	{
+		const size_t strideh = S / 2;
+		size_t x;
+
+		if (toggle) {
+			qas_x3_planned<T, S / 2>::prepare(b, plan, 1);
+			qas_x3_planned<T, S / 2>::prepare(b + strideh, plan, 1);
+			for (x = 0; x != strideh; x++)
+				b[x + strideh] += b[x];
+			qas_x3_planned<T, S / 2>::prepare(b + strideh, plan, 0);
+		} else {
+			qas_x3_planned<T, S / 2>::prepare(b + strideh, plan, 1);
+			for (x = 0; x != strideh; x++)
+				b[x + strideh] -= b[x];
+			qas_x3_planned<T, S / 2>::prepare(b + strideh, plan, 0);
+			qas_x3_planned<T, S / 2>::prepare(b, plan, 0);
+		}
+	}
+
+	static void
+	multiply(T *a, const T *&plan, T *ptr_low, T *ptr_high, const uint8_t toggle)
+	{
+		const size_t strideh = S / 2;
+		size_t x;
+
+		if (toggle) {
+
+			/* inverse step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = t0 + t1;
+				ptr_high[x] = t0 + t1 + t2 + t3;
+			}
+
+			qas_x3_planned<T, S / 2>::multiply(a, plan, ptr_low, ptr_low + strideh, 1);
+
+			for (x = 0; x != strideh; x++)
+				ptr_low[x + strideh] = -ptr_low[x + strideh];
+
+			qas_x3_planned<T, S / 2>::multiply(a + strideh, plan, ptr_low + strideh, ptr_high + strideh, 1);
+
+			/* forward step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = -t0 - t1;
+				ptr_high[x] = t2 + t1 - t3;
+
+				a[x + strideh] += a[x];
+			}
+
+			qas_x3_planned<T, S / 2>::multiply(a + strideh, plan, ptr_low + strideh, ptr_high, 0);
+		} else {
+			qas_x3_planned<T, S / 2>::multiply(a + strideh, plan, ptr_low + strideh, ptr_high, 1);
+
+			/* inverse step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = -t0 - t1;
+				ptr_high[x] = t0 + t1 + t2 + t3;
+
+				a[x + strideh] -= a[x];
+			}
+
+			qas_x3_planned<T, S / 2>::multiply(a + strideh, plan, ptr_low + strideh, ptr_high + strideh, 0);
+
+			for (x = 0; x != strideh; x++)
+				ptr_low[x + strideh] = -ptr_low[x + strideh];
+
+			qas_x3_planned<T, S / 2>::multiply(a, plan, ptr_low, ptr_low + strideh, 0);
+
+			/* forward step */
+			for (x = 0; x != strideh; x++) {
+				const T t0 = ptr_low[x];
+				const T t1 = ptr_low[x + strideh];
+				const T t2 = ptr_high[x];
+				const T t3 = ptr_high[x + strideh];
+
+				ptr_low[x + strideh] = t1 - t0;
+				ptr_high[x] = t2 - t1 - t3;
+			}
+		}
+	}
+};
+
+template <typename T>
+struct qas_x3_planned<T, QAS_X3_COMBA> {
+	static const size_t plan_size = QAS_X3_COMBA;
+
+	static void
+	prepare(T *b, T *&plan, const uint8_t)
+	{
+		memcpy(plan, b, sizeof(T) * QAS_X3_COMBA);
+		plan += QAS_X3_COMBA;
+	}
+
+	static void
+	multiply(T *a, const T *&plan, T *ptr_low, T *ptr_high, const uint8_t)
+	{
+		qas_x3_comba<T>::fn(a, plan, ptr_low, ptr_high);
+		plan += QAS_X3_COMBA;
+	}
+};
+
+/*
+ * Multiply the fixed input "vb" by "num" inputs, read from "va" at
+ * the given stride, using the compute type "T". Each product is
+ * added to "pc" at the given stride.
+ */
+template <typename T, typename U, size_t S>
+static void
+qas_x3_batch_fixed(const U *va, const size_t va_stride, const U *vb,
+    U *pc, const size_t pc_stride, const size_t num)
+{
+	T plan[qas_x3_planned<T, S>::plan_size] __attribute__((aligned(64)));
+	T a[S] __attribute__((aligned(64)));
+	T c[2 * S] __attribute__((aligned(64)));
+	T *pp = plan;
+
+	/* compute the plan once, using "a" as scratch */
+	for (size_t x = 0; x != S; x++)
+		a[x] = vb[x];
+	qas_x3_planned<T, S>::prepare(a, pp, 1);
+
+	for (size_t n = 0; n != num; n++) {
+		const U *pa = va + n * va_stride;
+		U *pd = pc + n * pc_stride;
+		const T *pq = plan;
+
+		for (size_t x = 0; x != S; x++)
+			a[x] = pa[x];
+		memset(c, 0, sizeof(c));
+
+		qas_x3_planned<T, S>::multiply(a, pq, c, c + S, 1);
+
+		for (size_t x = 0; x != 2 * S; x++)
+			pd[x] += c[x];
+	}
+}
+
+template <typename T, typename U, size_t S>
+struct qas_x3_batch_dispatch {
+	static bool
+	multiply(const U *va, const size_t va_stride, const U *vb,
+	    U *pc, const size_t pc_stride, const size_t num, const size_t max)
+	{
+		if (max != S) {
+			return (qas_x3_batch_dispatch<T, U, S / 2>::multiply(
+			    va, va_stride, vb, pc, pc_stride, num, max));
+		}
+		qas_x3_batch_fixed<T, U, S>(va, va_stride, vb, pc, pc_stride, num);
+		return (true);
+	}
+};
+
+template <typename T, typename U>
+struct qas_x3_batch_dispatch<T, U, QAS_X3_COMBA / 2> {
+	static bool
+	multiply(const U *, const size_t, const U *,
+	    U *, const size_t, const size_t, const size_t)
+	{
+		return (false);
+	}
+};
+
+/*
+ * <input size> = "max"
+ * <output size> = 2 * "max"
+ *
+ * The product is added to the output.
+ */
+void
+qas_x3_multiply_double(double *va, double *vb, double *pc, const size_t max)
+{
+	qas_x3_multiply<double>(va, vb, pc, max);
+}
+
+/*
+ * Same as qas_x3_multiply_double(), but computed in single precision.
+ */
+void
+qas_x3_multiply_double_as_float(const double *va, const double *vb, double *pc, const size_t max)
+{
+	/* check for non-power of two */
+	if (max == 0 || (max & (max - 1)))
+		return;
+
+	float a[max];
+	float b[max];
+	float c[2 * max];
+
+	for (size_t x = 0; x != max; x++) {
+		a[x] = va[x];
+		b[x] = vb[x];
+	}
+	memset(c, 0, sizeof(c));
+
+	qas_x3_multiply<float>(a, b, c, max);
+
+	for (size_t x = 0; x != 2 * max; x++)
+		pc[x] += c[x];
+}
+
+/*
+ * Multiply "num" inputs of size "max", starting at "va" and spaced
+ * "va_stride" apart, by the same input "vb". The product of input
+ * "n" is added to "pc + n * pc_stride". When both strides equal
+ * "max", this is an overlap-add convolution of a longer signal.
+ */
+void
+qas_x3_batch_double(const double *va, const size_t va_stride, const double *vb,
+    double *pc, const size_t pc_stride, const size_t num, const size_t max)
+{
+	if (qas_x3_comba<double>::fn != 0 &&
+	    qas_x3_batch_dispatch<double, double, QAS_MUL_SIZE>::multiply(
+	    va, va_stride, vb, pc, pc_stride, num, max))
+		return;
+
+	/* fallback */
+	for (size_t n = 0; n != num; n++)
+		qas_x3_multiply<double>(va + n * va_stride, vb, pc + n * pc_stride, max);
+}
+
+/*
+ * Same as qas_x3_batch_double(), but computed in single precision.
+ */
+void
+qas_x3_batch_double_as_float(const double *va, const size_t va_stride, const double *vb,
+    double *pc, const size_t pc_stride, const size_t num, const size_t max)
+{
+	if (qas_x3_comba<float>::fn != 0 &&
+	    qas_x3_batch_dispatch<float, double, QAS_MUL_SIZE>::multiply(
+	    va, va_stride, vb, pc, pc_stride, num, max))
+		return;
+
+	/* fallback */
+	for (size_t n = 0; n != num; n++)
+		qas_x3_multiply_double_as_float(va + n * va_stride, vb, pc + n * pc_stride, max);
+}
+
+void
+qas_x3_init()
+{
+	qas_x3_comba<double>::fn = &qas_x3_comba_double_generic;
+	qas_x3_comba<float>::fn = &qas_x3_comba_float_generic;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f")) {
+		qas_x3_comba<double>::fn = &qas_x3_comba_double_avx512;
+		qas_x3_comba<float>::fn = &qas_x3_comba_float_avx512;
+	} else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		qas_x3_comba<double>::fn = &qas_x3_comba_double_avx2;
+		qas_x3_comba<float>::fn = &qas_x3_comba_float_avx2;
+	}
+#endif
 }
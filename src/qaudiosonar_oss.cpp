@@ -44,8 +44,19 @@ size_t qas_mon_size;
 
 static struct dsp_buffer qas_read_buffer[2];
 static struct dsp_buffer qas_write_buffer[2];
+/*
+ * The monitor buffer is a ring of QAS_CORR_SIZE blocks, where each
+ * block is stored twice, so that the history of any frame is
+ * contiguous. Frames point directly into the ring. A block is not
+ * overwritten until all frames using it have been freed.
+ */
 static double *qas_mon_buffer;
+static size_t qas_mon_blocks;
 static size_t qas_mon_level;
+static size_t qas_mon_generation;	/* protected by atomic_lock() */
+static uint8_t *qas_mon_live;	/* frames in flight, by sequence number */
+static size_t qas_mon_slack;
+static int qas_mon_clear;	/* ring should be cleared by the producer */
 
 void
 dsp_put_sample(struct dsp_buffer *dbuf, double sample)
@@ -192,9 +203,9 @@ qas_dsp_audio_producer(void *arg)
 			temp[1][QAS_CORR_SIZE + x] = 0;
 		}
 
-		for (size_t x = 0; x != QAS_DSP_SIZE; x += QAS_CORR_SIZE) {
-			qas_x3_multiply_double(qas_band_pass_filter, noise[0] + x, temp[0] + x, QAS_CORR_SIZE);
-			qas_x3_multiply_double(qas_band_pass_filter, noise[1] + x, temp[1] + x, QAS_CORR_SIZE);
+		for (size_t x = 0; x != 2; x++) {
+			qas_conv_batch_double(noise[x], QAS_CORR_SIZE, qas_band_pass_filter,
+			    temp[x], QAS_CORR_SIZE, QAS_DSP_SIZE / QAS_CORR_SIZE, QAS_CORR_SIZE);
 		}
 
 		atomic_lock();
@@ -214,13 +225,49 @@ qas_dsp_audio_producer(void *arg)
 	return (0);
 }
 
+/*
+ * Release the monitor blocks used by the given frame.
+ */
+void
+qas_dsp_release(size_t sequence_number)
+{
+	atomic_lock();
+	qas_mon_live[sequence_number % qas_mon_slack] = 0;
+	atomic_wakeup();
+	atomic_unlock();
+}
+
+/*
+ * Returns the current monitor buffer generation.
+ */
+size_t
+qas_dsp_generation(void)
+{
+	size_t retval;
+
+	atomic_lock();
+	retval = qas_mon_generation;
+	atomic_unlock();
+
+	return (retval);
+}
+
 void
 qas_dsp_sync(void)
 {
-	atomic_graph_lock();
-	memset(qas_mon_buffer, 0, sizeof(double) * qas_mon_size);
-	memset(qas_mon_decay, 0, sizeof(double) * qas_window_size);
-	atomic_graph_unlock();
+	/*
+	 * Queued frames of the old generation are dropped by the
+	 * workers. Frames already being analyzed still use the ring,
+	 * so it is cleared by the producer after they have been freed.
+	 */
+	atomic_lock();
+	qas_mon_generation++;
+	qas_mon_clear = 1;
+	atomic_unlock();
+
+	qas_corr_decay_reset();
+
+	qas_wave_reset();
 
 	atomic_lock();
 	while (dsp_read_space(&qas_read_buffer[0]))
@@ -264,34 +311,55 @@ qas_dsp_audio_analyzer(void *arg)
 		dsp_rd_audio = dsp_rd_data[qas_source_1];
 		atomic_unlock();
 
-		/* copy monitor samples */
-		atomic_graph_lock();
-		memcpy(qas_mon_buffer + qas_mon_level,
-		    dsp_rd_monitor, QAS_CORR_SIZE * sizeof(qas_mon_buffer[0]));
-		atomic_graph_unlock();
-
-		/* update counters */
-		qas_mon_level += QAS_CORR_SIZE;
-		qas_mon_level %= qas_mon_size;
-
 		struct qas_corr_data *ptr = qas_corr_alloc();
 
+		/* wait for the oldest frame using the next block to be freed */
 		atomic_lock();
+		if (qas_mon_clear) {
+			/* wait for all frames to be freed */
+			for (size_t x = 0; x != qas_mon_slack; x++) {
+				while (qas_mon_live[x] != 0)
+					atomic_wait();
+			}
+			memset(qas_mon_buffer, 0, sizeof(double) * 2 *
+			    QAS_CORR_SIZE * qas_mon_blocks);
+			qas_mon_clear = 0;
+		}
+		while (qas_mon_live[qas_in_sequence_number % qas_mon_slack] != 0)
+			atomic_wait();
+		qas_mon_live[qas_in_sequence_number % qas_mon_slack] = 1;
 		ptr->sequence_number = qas_in_sequence_number++;
+		ptr->generation = qas_mon_generation;
 		atomic_unlock();
 
+		/* copy monitor samples, twice */
 		atomic_graph_lock();
-		for (size_t x = 0; x != qas_mon_size; x += QAS_CORR_SIZE) {
-			size_t y = (x + qas_mon_level) % qas_mon_size;
-			memcpy(ptr->monitor_data + x, qas_mon_buffer + y,
-			       sizeof(double) * QAS_CORR_SIZE);
-		}
+		memcpy(qas_mon_buffer + qas_mon_level * QAS_CORR_SIZE,
+		    dsp_rd_monitor, QAS_CORR_SIZE * sizeof(qas_mon_buffer[0]));
+		memcpy(qas_mon_buffer + (qas_mon_level + qas_mon_blocks) * QAS_CORR_SIZE,
+		    dsp_rd_monitor, QAS_CORR_SIZE * sizeof(qas_mon_buffer[0]));
+
+		ptr->monitor_data = qas_mon_buffer +
+		    (qas_mon_level + qas_mon_blocks + 1) * QAS_CORR_SIZE - qas_mon_size;
 		atomic_graph_unlock();
 
+		/* update counters */
+		qas_mon_level++;
+		qas_mon_level %= qas_mon_blocks;
+
 		/* compute reversed audio samples */
 		for (size_t x = 0; x != QAS_CORR_SIZE; x++)
 			ptr->input_data[x] = dsp_rd_audio[QAS_CORR_SIZE - 1 - x];
 
+		/* the additional channels share the monitor samples */
+		for (size_t ch = 1; ch != qas_corr_channels; ch++) {
+			const double *pin = dsp_rd_data[qas_corr_source[ch]];
+			double *pout = ptr->input_data + ch * QAS_CORR_SIZE;
+
+			for (size_t x = 0; x != QAS_CORR_SIZE; x++)
+				pout[x] = pin[QAS_CORR_SIZE - 1 - x];
+		}
+
 		qas_corr_insert(ptr);
 	}
 	return (0);
@@ -377,8 +445,15 @@ qas_dsp_init()
 	pthread_t td;
 
 	qas_mon_size = qas_window_size + QAS_CORR_SIZE;
-	qas_mon_buffer = (double *)malloc(sizeof(double) * qas_mon_size);
-	memset(qas_mon_buffer, 0, sizeof(double) * qas_mon_size);
+
+	/* allow one display history of frames in flight */
+	qas_mon_slack = qas_display_hist_max;
+	qas_mon_live = (uint8_t *)malloc(qas_mon_slack);
+	memset(qas_mon_live, 0, qas_mon_slack);
+
+	qas_mon_blocks = qas_mon_size / QAS_CORR_SIZE + qas_mon_slack;
+	qas_mon_buffer = (double *)malloc(sizeof(double) * 2 * QAS_CORR_SIZE * qas_mon_blocks);
+	memset(qas_mon_buffer, 0, sizeof(double) * 2 * QAS_CORR_SIZE * qas_mon_blocks);
 
 	pthread_create(&td, 0, &qas_dsp_audio_producer, 0);
 	pthread_create(&td, 0, &qas_dsp_audio_analyzer, 0);
@@ -43,6 +43,52 @@ QasSpectrum :: handle_decay_0(int _value)
 	atomic_graph_unlock();
 }
 
+void
+QasSpectrum :: handle_engine(int _value)
+{
+	atomic_graph_lock();
+	qas_engine = _value;
+	atomic_graph_unlock();
+
+	/* the running sums are not fed by the other engines */
+	if (qas_wave_incremental)
+		qas_wave_reset();
+}
+
+void
+QasSpectrum :: handle_range(int _value)
+{
+	static const double range[][2] = {
+		{ 0.0, 0.0 },
+		{ 20.0, 200.0 },
+		{ 100.0, 1000.0 },
+		{ 200.0, 2000.0 },
+		{ 1000.0, 10000.0 },
+		{ 2000.0, 20000.0 },
+	};
+	size_t start;
+	size_t stop;
+
+	if (_value <= 0 || _value >= (int)(sizeof(range) / sizeof(range[0]))) {
+		start = 0;
+		stop = qas_num_bands;
+	} else {
+		start = qas_wave_freq_to_band(range[_value][0]);
+		start -= start % QAS_WAVE_STEP;
+		stop = qas_wave_freq_to_band(range[_value][1]);
+		stop += QAS_WAVE_STEP - (stop % QAS_WAVE_STEP);
+	}
+
+	atomic_graph_lock();
+	qas_band_start = start;
+	qas_band_stop = stop;
+	atomic_graph_unlock();
+
+	/* the running sums are no longer valid */
+	if (qas_wave_incremental)
+		qas_wave_reset();
+}
+
 QasBand :: QasBand(QasSpectrum *_ps)
 {
 	ps = _ps;
@@ -277,10 +323,11 @@ QasGraph :: getText(QMouseEvent *event)
 	switch (graph) {
 	case 0:
 	case 1:
-		band = (qas_num_bands * event->x()) / width();
-		if (band > -1 && band < (int)qas_num_bands) {
+		band = qas_band_start +
+		    ((qas_band_stop - qas_band_start) * event->x()) / width();
+		if (band > -1 && band < (int)qas_band_stop) {
 			band -= band % QAS_WAVE_STEP;
-			return QString(qas_descr_table[band]) +
+			return qas_descr(band) +
 			  QString(" /* %1Hz */").arg(QAS_FREQ_TABLE_ROUNDED(band));
 		} else {
 			return QString();
@@ -332,13 +379,57 @@ QasReference(double a, double b, double c)
 	return (max);
 }
 
+/*
+ * Trace colors of the additional correlation channels.
+ */
+static const uint8_t QasChannelColor[QAS_CORR_CHANNELS_MAX][3] = {
+	{ 255, 0, 0 },
+	{ 0, 0, 255 },
+	{ 0, 160, 0 },
+	{ 255, 128, 0 },
+	{ 160, 0, 160 },
+	{ 0, 160, 160 },
+	{ 128, 128, 0 },
+	{ 96, 96, 96 },
+};
+
+/*
+ * Return the fractional position of a peak, using parabolic
+ * interpolation between its neighbours.
+ */
+static double
+QasInterpolate(const double *data, size_t x, size_t max)
+{
+	double a, b, c, d;
+
+	if (x == 0 || x + 1 >= max)
+		return (0.0);
+
+	a = data[x - 1];
+	b = data[x];
+	c = data[x + 1];
+	d = a - 2.0 * b + c;
+
+	if (d == 0.0)
+		return (0.0);
+
+	d = 0.5 * (a - c) / d;
+
+	if (d < -0.5)
+		d = -0.5;
+	else if (d > 0.5)
+		d = 0.5;
+	return (d);
+}
+
 void
 QasGraph :: paintEvent(QPaintEvent *event)
 {
 	QPainter paint(this);
 	int w = width();
 	int h = height();
-	size_t wi = qas_display_width() / 3;
+	size_t xs = qas_band_start / QAS_WAVE_STEP;
+	size_t wi = (qas_band_stop - qas_band_start) / QAS_WAVE_STEP;
 	size_t hi;
 	size_t hg = h / 6 + 1;
 	size_t rg = h / 3 + 1;
@@ -346,10 +437,12 @@ QasGraph :: paintEvent(QPaintEvent *event)
 	double corr_max_power;
 	double corr_min_power;
 	double corr_abs_power;
-	size_t corr_max_off;
-	size_t corr_min_off;
+	double corr_max_off;
+	double corr_min_off;
 	size_t corr_range_min_off;
 	size_t corr_range_max_off;
+	double chan_power[QAS_CORR_CHANNELS_MAX];
+	double chan_off[QAS_CORR_CHANNELS_MAX];
 
 	if (w == 0 || h == 0)
 		return;
@@ -369,17 +462,19 @@ QasGraph :: paintEvent(QPaintEvent *event)
 	power.fill(transparent);
 	corr.fill(transparent);
 
-	atomic_graph_lock();
+	/* the snapshot is stable, no locking needed */
+	const double *corr_decay = qas_corr_decay_snapshot();
+
 	do {
 		size_t x, t, u;
 		for (t = u = x = wc_range.start; x != wc_range.stop + 1; x++) {
-			if (qas_mon_decay[x] > qas_mon_decay[t])
+			if (corr_decay[x] > corr_decay[t])
 				t = x;
-			if (qas_mon_decay[x] < qas_mon_decay[u])
+			if (corr_decay[x] < corr_decay[u])
 				u = x;
 		}
-		corr_max_power = qas_mon_decay[t];
-		corr_min_power = qas_mon_decay[u];
+		corr_max_power = corr_decay[t];
+		corr_min_power = corr_decay[u];
 
 		if (corr_max_power < 1.0)
 			corr_max_power = 1.0;
@@ -391,12 +486,29 @@ QasGraph :: paintEvent(QPaintEvent *event)
 		else
 			corr_abs_power = - corr_min_power;
 
-		corr_max_off = qas_window_size - 1 - t;
-		corr_min_off = qas_window_size - 1 - u;
+		corr_max_off = (qas_window_size - 1 - t) -
+		    QasInterpolate(corr_decay, t, qas_window_size);
+		corr_min_off = (qas_window_size - 1 - u) -
+		    QasInterpolate(corr_decay, u, qas_window_size);
 
 		corr_range_min_off = qas_window_size - 1 - wc_range.stop;
 		corr_range_max_off = qas_window_size - 1 - wc_range.start;
 
+		/* find the strongest peak of the additional channels */
+		for (size_t ch = 1; ch != qas_corr_channels; ch++) {
+			const double *pdecay = corr_decay + ch * qas_window_size;
+
+			for (t = x = wc_range.start; x != wc_range.stop + 1; x++) {
+				if (fabs(pdecay[x]) > fabs(pdecay[t]))
+					t = x;
+			}
+			chan_power[ch] = fabs(pdecay[t]);
+			if (chan_power[ch] < 1.0)
+				chan_power[ch] = 1.0;
+			chan_off[ch] = (qas_window_size - 1 - t) -
+			    QasInterpolate(pdecay, t, qas_window_size);
+		}
+
 		for (u = 0, t = wc_range.start; t != wc_range.stop + 1; t++) {
 			x = ((t - wc_range.start) * (w - 1)) /
 			    (1 + wc_range.stop - wc_range.start);
@@ -410,7 +522,7 @@ QasGraph :: paintEvent(QPaintEvent *event)
 				u = (size_t)w;
 
 			for (; x != u; x++) {
-				int value = (1.0 - (qas_mon_decay[t] / corr_abs_power)) * (double)(hg / 2);
+				int value = (1.0 - (corr_decay[t] / corr_abs_power)) * (double)(hg / 2);
 
 				if (value < 0)
 					value = 0;
@@ -431,10 +543,50 @@ QasGraph :: paintEvent(QPaintEvent *event)
 					corr.setPixelColor(x, value, corr_c);
 			}
 		}
+
+		/* draw the additional channels as lines, each at its own scale */
+		for (size_t ch = 1; ch != qas_corr_channels; ch++) {
+			const double *pdecay = corr_decay + ch * qas_window_size;
+			const QColor chan_c(QasChannelColor[ch][0],
+			    QasChannelColor[ch][1], QasChannelColor[ch][2], 255);
+			int last = -1;
+
+			for (t = wc_range.start; t != wc_range.stop + 1; t++) {
+				x = ((t - wc_range.start) * (w - 1)) /
+				    (1 + wc_range.stop - wc_range.start);
+
+				u = ((1 + t - wc_range.start) * (w - 1)) /
+				    (1 + wc_range.stop - wc_range.start);
+
+				if (x > (size_t)(w - 1))
+					x = (size_t)(w - 1);
+				if (u > (size_t)w)
+					u = (size_t)w;
+
+				int value = (1.0 - (pdecay[t] / chan_power[ch])) * (double)(hg / 2);
+
+				if (value < 0)
+					value = 0;
+				else if (value > (int)(hg - 1))
+					value = (int)(hg - 1);
+				if (last < 0)
+					last = value;
+
+				for (; x != u; x++) {
+					/* connect to the previous point */
+					for (int y = last; y != value; y += (y < value) ? 1 : -1)
+						corr.setPixelColor(x, y, chan_c);
+					corr.setPixelColor(x, value, chan_c);
+					last = value;
+				}
+			}
+		}
 	} while (0);
 
+	atomic_graph_lock();
+
 	for (size_t y = 0; y != hi; y++) {
-		double *data = qas_display_get_line(y + seq);
+		double *data = qas_display_get_line(y + seq) + 3 * xs;
 		double max;
 		size_t x, z;
 
@@ -518,13 +670,13 @@ QasGraph :: paintEvent(QPaintEvent *event)
 		      "RANGE :: %9 samples %10 - %11ms\n"
 		      "LAG :: %12")
 	   .arg(10.0 * log(corr_max_power) / log(10))
-	   .arg(corr_max_off)
-	   .arg((double)((int)((corr_max_off * 100000ULL) / qas_sample_rate) / 100.0))
-	   .arg((double)((int)((corr_max_off * 34000ULL) / qas_sample_rate) / 100.0))
+	   .arg(corr_max_off, 0, 'f', 2)
+	   .arg((double)((int)((corr_max_off * 100000.0) / qas_sample_rate) / 100.0))
+	   .arg((double)((int)((corr_max_off * 34000.0) / qas_sample_rate) / 100.0))
 	   .arg(10.0 * log(- corr_min_power) / log(10))
-	   .arg(corr_min_off)
-	   .arg((double)((int)((corr_min_off * 100000ULL) / qas_sample_rate) / 100.0))
-	   .arg((double)((int)((corr_min_off * 34000ULL) / qas_sample_rate) / 100.0))
+	   .arg(corr_min_off, 0, 'f', 2)
+	   .arg((double)((int)((corr_min_off * 100000.0) / qas_sample_rate) / 100.0))
+	   .arg((double)((int)((corr_min_off * 34000.0) / qas_sample_rate) / 100.0))
 	   .arg(1 + corr_range_max_off - corr_range_min_off)
 	   .arg((double)((int)((corr_range_min_off * 100000ULL) / qas_sample_rate) / 100.0))
 	   .arg((double)((int)((corr_range_max_off * 100000ULL) / qas_sample_rate) / 100.0))
@@ -543,13 +695,37 @@ QasGraph :: paintEvent(QPaintEvent *event)
 	paint.setBrush(black);
 	paint.drawText(QRect(0,0,w,h),Qt::AlignLeft | Qt::AlignTop,str,&br);
 
+	/* one line per additional channel, in the color of its trace */
+	for (size_t ch = 1; ch != qas_corr_channels; ch++) {
+		const QColor chan_c(QasChannelColor[ch][0],
+		    QasChannelColor[ch][1], QasChannelColor[ch][2], 255);
+		const int top = br.bottom() + 1;
+
+		str = QString("CH%1 (%2) :: %3dB %4 samples %5ms %6m")
+		   .arg(ch)
+		   .arg(qas_corr_source[ch])
+		   .arg(10.0 * log(chan_power[ch]) / log(10))
+		   .arg(chan_off[ch], 0, 'f', 2)
+		   .arg((double)((int)((chan_off[ch] * 100000.0) / qas_sample_rate) / 100.0))
+		   .arg((double)((int)((chan_off[ch] * 34000.0) / qas_sample_rate) / 100.0));
+
+		paint.setPen(QPen(chan_c,0));
+		paint.drawText(QRect(0,top,w,h - top),Qt::AlignLeft | Qt::AlignTop,str,&br);
+		paint.setPen(QPen(black,-1));
+		paint.setBrush(QColor(255,255,255,128));
+		paint.drawRect(br);
+		paint.setPen(QPen(chan_c,0));
+		paint.setBrush(chan_c);
+		paint.drawText(QRect(0,top,w,h - top),Qt::AlignLeft | Qt::AlignTop,str,&br);
+	}
+
 	uint8_t iso_num = 255;
 	int last_x = 0;
 	int diff_y = 0;
 	for (size_t x = 0; x != wi; x++) {
-		if (iso_num == qas_iso_table[x])
+		if (iso_num == qas_iso_table[x + xs])
 			continue;
-		iso_num = qas_iso_table[x];
+		iso_num = qas_iso_table[x + xs];
 		double freq = qas_iso_freq_table[iso_num];
 		if (freq >= 1000.0)
 			str = QString("%1.%2kHz").arg((int)(freq / 1000.0)).arg((int)(freq / 100.0) % 10);
@@ -615,21 +791,25 @@ QasSpectrum :: QasSpectrum()
 	connect(pb, SIGNAL(released()), this, SLOT(handle_tog_record()));
 	gl->addWidget(pb, 1,2,1,1);
 
+	pb = new QPushButton(tr("Toggle\nTuner"));
+	connect(pb, SIGNAL(released()), this, SLOT(handle_tog_tuner()));
+	gl->addWidget(pb, 1,3,1,1);
+
 	pb = new QPushButton(tr("Zoom\nLeft"));
 	connect(pb, SIGNAL(released()), this, SLOT(handle_zoom_left()));
-	gl->addWidget(pb, 1,3,1,1);
+	gl->addWidget(pb, 1,4,1,1);
 
 	pb = new QPushButton(tr("Zoom\nMiddle"));
 	connect(pb, SIGNAL(released()), this, SLOT(handle_zoom_middle()));
-	gl->addWidget(pb, 1,4,1,1);
+	gl->addWidget(pb, 1,5,1,1);
 
 	pb = new QPushButton(tr("Zoom\nRight"));
 	connect(pb, SIGNAL(released()), this, SLOT(handle_zoom_right()));
-	gl->addWidget(pb, 1,5,1,1);
+	gl->addWidget(pb, 1,6,1,1);
 
 	pb = new QPushButton(tr("Zoom\nOut"));
 	connect(pb, SIGNAL(released()), this, SLOT(handle_zoom_out()));
-	gl->addWidget(pb, 1,6,1,1);
+	gl->addWidget(pb, 1,7,1,1);
 
 	tuning = new QSpinBox();
 	tuning->setRange(-999,999);
@@ -650,14 +830,27 @@ QasSpectrum :: QasSpectrum()
 
 	connect(map_decay_0, SIGNAL(selectionChanged(int)), this, SLOT(handle_decay_0(int)));
 
+	map_range = new QasButtonMap("Frequency range\0"
+				     "ALL\0" "20-200Hz\0" "100Hz-1kHz\0" "200Hz-2kHz\0"
+				     "1-10kHz\0" "2-20kHz\0", 6, 6);
+
+	connect(map_range, SIGNAL(selectionChanged(int)), this, SLOT(handle_range(int)));
+
+	map_engine = new QasButtonMap("Analysis engine\0"
+				      "TRIANGLE\0" "YIN\0" "CQT\0" "GOERTZEL\0", 4, 4);
+
+	connect(map_engine, SIGNAL(selectionChanged(int)), this, SLOT(handle_engine(int)));
+
 	edit = new QPlainTextEdit();
 
 	qbw = new QWidget();
 	glb = new QGridLayout(qbw);
 
-	gl->addWidget(map_decay_0, 0,0,1,7);
-	gl->addWidget(qbw, 0,7,4,1);
-	gl->addWidget(qg, 2,0,2,7);
+	gl->addWidget(map_decay_0, 0,0,1,8);
+	gl->addWidget(qbw, 0,8,5,1);
+	gl->addWidget(qg, 2,0,2,8);
+	gl->addWidget(map_range, 4,0,1,4);
+	gl->addWidget(map_engine, 4,4,1,4);
 	gl->setRowStretch(2,2);
 	gl->setColumnStretch(0,1);
 	gl->setColumnStretch(1,1);
@@ -666,6 +859,7 @@ QasSpectrum :: QasSpectrum()
 	gl->setColumnStretch(4,1);
 	gl->setColumnStretch(5,1);
 	gl->setColumnStretch(6,1);
+	gl->setColumnStretch(7,1);
 
 	glb->addWidget(lbl_max, 1,0,1,1);
 	glb->addWidget(tuning, 2,0,1,1);
@@ -686,6 +880,7 @@ QasSpectrum :: handle_reset()
 	zoom_range[0].start = 0;
 	zoom_range[0].stop = qas_window_size - 1;
 	zoom_level = 0;
+	update_zoom();
 
 	qas_dsp_sync();
 }
@@ -694,6 +889,9 @@ void
 QasSpectrum :: handle_tuning()
 {
 	qas_tuning = pow(2.0, (double)tuning->value() / 12000.0);
+
+	/* rebuild the constant-Q kernels */
+	qas_cqt_retune();
 }
 
 void
@@ -727,6 +925,25 @@ QasSpectrum :: handle_tog_record()
 	atomic_unlock();
 }
 
+void
+QasSpectrum :: handle_tog_tuner()
+{
+	atomic_lock();
+	qas_tuner = !qas_tuner;
+	atomic_unlock();
+}
+
+void
+QasSpectrum :: update_zoom()
+{
+	const QasZoomRange &range = zoom_range[zoom_level];
+
+	atomic_graph_lock();
+	qas_corr_lag_start = range.start;
+	qas_corr_lag_stop = range.stop + 1;
+	atomic_graph_unlock();
+}
+
 void
 QasSpectrum :: handle_zoom_right()
 {
@@ -743,6 +960,7 @@ QasSpectrum :: handle_zoom_right()
 
 	zoom_range[zoom_level].start = zoom_range[zoom_level - 1].start + half;
 	zoom_range[zoom_level].stop = zoom_range[zoom_level - 1].stop;
+	update_zoom();
 }
 
 void
@@ -761,6 +979,7 @@ QasSpectrum :: handle_zoom_left()
 
 	zoom_range[zoom_level].start = zoom_range[zoom_level - 1].start;
 	zoom_range[zoom_level].stop = zoom_range[zoom_level - 1].stop - half;
+	update_zoom();
 }
 
 void
@@ -779,6 +998,7 @@ QasSpectrum :: handle_zoom_middle()
 
 	zoom_range[zoom_level].start = zoom_range[zoom_level - 1].start + quarter;
 	zoom_range[zoom_level].stop = zoom_range[zoom_level - 1].stop - quarter;
+	update_zoom();
 }
 
 void
@@ -790,4 +1010,5 @@ QasSpectrum :: handle_zoom_out()
 	} else {
 		zoom_level--;
 	}
+	update_zoom();
 }
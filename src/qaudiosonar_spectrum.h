@@ -74,6 +74,8 @@ class QasSpectrum : public QWidget {
 public:
 	QasSpectrum();
 
+	void update_zoom();
+
 	void closeEvent (QCloseEvent *event) {
 		QCoreApplication::exit();
 	};
@@ -91,6 +93,8 @@ public:
 	QSpinBox *tuning;
 	QSlider *sensitivity;
 	QasButtonMap *map_decay_0;
+	QasButtonMap *map_range;
+	QasButtonMap *map_engine;
 
 signals:
 	void handle_append_text(const QString);
@@ -99,10 +103,13 @@ public slots:
 	void handle_reset();
 	void handle_tog_freeze();
 	void handle_tog_record();
+	void handle_tog_tuner();
 	void handle_slider(int);
 	void handle_tuning();
 	void handle_sensitivity();
 	void handle_decay_0(int);
+	void handle_range(int);
+	void handle_engine(int);
 	void handle_zoom_right();
 	void handle_zoom_left();
 	void handle_zoom_middle();
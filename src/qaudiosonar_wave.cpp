@@ -28,13 +28,79 @@
 static pthread_cond_t qas_wave_cond;
 static pthread_mutex_t qas_wave_mutex;
 
+static pthread_mutex_t qas_wave_sum_mutex;
+static pthread_mutex_t qas_wave_sparse_mutex;
+
 static TAILQ_HEAD(,qas_wave_job) qas_wave_head = TAILQ_HEAD_INITIALIZER(qas_wave_head);
 
 double qas_tuning = 1.0;
 double *qas_freq_table;
-QString *qas_descr_table;
 size_t qas_num_bands;
 double qas_low_octave;
+size_t qas_band_start;
+size_t qas_band_stop;
+int qas_wave_incremental;
+int qas_wave_pyramid;
+int qas_wave_constant_q;
+int qas_wave_interpolate;
+int qas_wave_sparse;
+int qas_engine;
+
+/*
+ * The octave pyramid holds successively half-band filtered and
+ * decimated copies of the monitor data. Each 1st scan band is
+ * analyzed at the lowest sample rate that is at least four times its
+ * frequency.
+ */
+#define	QAS_WAVE_HALF_BAND 8	/* non-zero taps on each side */
+#define	QAS_WAVE_LEVEL_MAX QAS_MUL_ORDER
+
+static double qas_wave_half_band[QAS_WAVE_HALF_BAND];
+static uint8_t *qas_wave_level;
+static uint8_t qas_wave_level_max;
+
+/*
+ * In constant-Q mode each band is analyzed over the given number of
+ * periods, which gives a resolution of about half a semitone:
+ */
+#define	QAS_WAVE_PERIODS 32
+
+static size_t *qas_wave_length;
+
+/*
+ * Per band and per QAS_CORR_SIZE block partial sums of the
+ * triangular cosine and sine products, used by the incremental
+ * analysis mode. Frames complete out of order when there are
+ * multiple workers, so each slot is tagged with the block number
+ * plus one it holds, zero meaning empty:
+ */
+struct qas_wave_sum {
+	double cos_in;
+	double sin_in;
+	size_t block;
+};
+
+static double qas_wave_refine_time;	/* seconds */
+
+/*
+ * In sparse mode bands which stayed below the sensitivity level for
+ * QAS_WAVE_QUIET frames are only analyzed every QAS_WAVE_QUIET frames.
+ * Their last value is used in between.
+ */
+#define	QAS_WAVE_QUIET 8
+
+struct qas_wave_band {
+	double value;
+	uint8_t quiet;
+	uint8_t peak;
+};
+
+static struct qas_wave_band *qas_wave_band;	/* protected by "qas_wave_sparse_mutex" */
+
+static struct qas_wave_sum *qas_wave_sum_data;
+static double *qas_wave_sum_phase;
+static size_t qas_wave_sum_blocks;
+static size_t qas_wave_sum_first;	/* first sequence number after reset */
 
 struct qas_wave_job *
 qas_wave_job_alloc()
@@ -99,27 +165,362 @@ qas_wave_unlock()
 }
 
 static void
-qas_wave_analyze(const double *indata, double delta_phase, double *out)
+qas_wave_decimate(const double *in, size_t num, double *out)
+{
+	for (size_t n = 0; n != num / 2; n++) {
+		double sum = 0.5 * in[2 * n];
+
+		for (size_t j = 0; j != QAS_WAVE_HALF_BAND; j++) {
+			const size_t k = 2 * j + 1;
+			double temp = 0.0;
+
+			if (2 * n >= k)
+				temp += in[2 * n - k];
+			if (2 * n + k < num)
+				temp += in[2 * n + k];
+			sum += qas_wave_half_band[j] * temp;
+		}
+		out[n] = sum;
+	}
+}
+
+static double *
+qas_wave_pyramid_level(const struct qas_corr_data *pdata, uint8_t level)
+{
+	if (level == 0)
+		return (pdata->monitor_data);
+	else
+		return (pdata->pyramid_data + qas_window_size - (qas_window_size >> (level - 1)));
+}
+
+void
+qas_wave_pyramid_build(struct qas_corr_data *pdata)
+{
+	for (uint8_t level = 1; level <= qas_wave_level_max; level++) {
+		qas_wave_decimate(qas_wave_pyramid_level(pdata, level - 1),
+		    qas_window_size >> (level - 1),
+		    qas_wave_pyramid_level(pdata, level));
+	}
+}
+
+static uint8_t
+qas_wave_get_level(size_t band)
+{
+	if (qas_wave_pyramid)
+		return (qas_wave_level[band / QAS_WAVE_STEP]);
+	else
+		return (0);
+}
+
+/*
+ * Returns the number of full rate samples to analyze for the given
+ * band. In constant-Q mode this is a fixed number of periods, rounded
+ * up to a multiple of QAS_CORR_SIZE.
+ */
+static size_t
+qas_wave_get_length(size_t band)
+{
+	if (qas_wave_constant_q || qas_tuner)
+		return (qas_wave_length[band / QAS_WAVE_STEP]);
+	else
+		return (qas_window_size);
+}
+
+/*
+ * Returns the input samples to use for the given band. The newest
+ * samples are always at the end of the input.
+ */
+static const double *
+qas_wave_input(const struct qas_corr_data *pdata, size_t band, size_t *pnum, double *pscale)
+{
+	const uint8_t level = qas_wave_get_level(band);
+	const size_t length = qas_wave_get_length(band);
+
+	*pnum = length >> level;
+	*pscale = (double)(1U << level);
+	return (qas_wave_pyramid_level(pdata, level) + ((qas_window_size - length) >> level));
+}
+
+/*
+ * Compute the amplitude of the given bands. The Goertzel engine
+ * correlates against sine waves instead of triangular waves.
+ */
+static void
+qas_wave_analyze_multi(const struct qas_corr_data *pdata, size_t band,
+    size_t stride, size_t count, double *out)
+{
+	const int sine = (pdata->engine == QAS_ENGINE_GOERTZEL);
+	const double *indata[count];
+	size_t num[count];
+	double phase[count];
+	double dp[count];
+	double coeff[count];
+	double cos_in[count];
+	double sin_in[count];
+	double cos_temp[count];
+	double sin_temp[count];
+
+	for (size_t x = 0; x != count; x++) {
+		double scale;
+
+		indata[x] = qas_wave_input(pdata, band + x * stride, num + x, &scale);
+		phase[x] = 0.0;
+		dp[x] = qas_tuning * qas_freq_table[band + x * stride] *
+		    scale / (double)qas_sample_rate;
+		cos_in[x] = 0.0;
+		sin_in[x] = 0.0;
+
+		coeff[x] = 2.0 * cos(2.0 * M_PI * dp[x]);
+	}
+
+	for (size_t x = 0; x != count; ) {
+		const uint8_t level = qas_wave_get_level(band + x * stride);
+		size_t y;
+
+		/* find bands using the same pyramid level */
+		for (y = x + 1; y != count; y++) {
+			if (qas_wave_get_level(band + y * stride) != level)
+				break;
+		}
+
+		/*
+		 * The number of samples is non-increasing with the
+		 * band. Each band joins the computation when its input
+		 * starts, while its phase starts at zero.
+		 */
+		for (size_t z = x; z != y; z++) {
+			const size_t end = (z + 1 != y) ?
+			    (size_t)(indata[z + 1] - indata[x]) : num[x];
+			const size_t start = indata[z] - indata[x];
+
+			if (start == end)
+				continue;
+
+			if (sine) {
+				/* the filter state is kept in "cos_in" and "sin_in" */
+				qas_ftt_goertzel(indata[z], end - start, coeff + x,
+				    cos_in + x, sin_in + x, z + 1 - x);
+				continue;
+			}
+
+			qas_ftt_multi(indata[z], end - start, phase + x, dp + x,
+			    cos_temp + x, sin_temp + x, z + 1 - x);
+
+			for (size_t t = x; t != z + 1; t++) {
+				cos_in[t] += cos_temp[t];
+				sin_in[t] += sin_temp[t];
+			}
+		}
+
+		for (; x != y; x++) {
+			if (sine) {
+				const double power = cos_in[x] * cos_in[x] +
+				    sin_in[x] * sin_in[x] - coeff[x] * cos_in[x] * sin_in[x];
+				out[x] = sqrt(power > 0.0 ? power : 0.0) / ((double)num[x] * 0.5);
+			} else {
+				out[x] = (fabs(cos_in[x]) + fabs(sin_in[x])) / ((double)num[x] * 0.5);
+			}
+			if (out[x] < 1.0)
+				out[x] = 1.0;
+		}
+	}
+}
+
+static void
+qas_wave_analyze(const struct qas_corr_data *pdata, size_t band, double *out)
 {
+	const double *indata;
 	double phase = 0.0;
-	double cos_in = 0.0;
-	double sin_in = 0.0;
+	double cos_in;
+	double sin_in;
+	double scale;
+	double dp;
+	size_t num;
 
-	for (size_t x = 0; x != qas_window_size; x++) {
-		cos_in += qas_ftt_cos(phase) * indata[x];
-		sin_in += qas_ftt_sin(phase) * indata[x];
-		phase += delta_phase;
+	if (pdata->engine == QAS_ENGINE_GOERTZEL) {
+		qas_wave_analyze_multi(pdata, band, 0, 1, out);
+		return;
 	}
 
-	out[0] = (fabs(cos_in) + fabs(sin_in)) / ((double)qas_window_size * 0.5);
+	indata = qas_wave_input(pdata, band, &num, &scale);
+	dp = qas_tuning * qas_freq_table[band] * scale / (double)qas_sample_rate;
+
+	qas_ftt_multi(indata, num, &phase, &dp, &cos_in, &sin_in, 1);
+
+	out[0] = (fabs(cos_in) + fabs(sin_in)) / ((double)num * 0.5);
 	if (out[0] < 1.0)
 		out[0] = 1.0;
 }
 
+/*
+ * Compute the newest QAS_CORR_SIZE block contribution only and
+ * combine it with the partial sums of the previous blocks, instead
+ * of scanning the whole window again. The phase is referenced to
+ * the absolute block number, so that the partial sums of different
+ * frames line up.
+ */
+static void
+qas_wave_analyze_incremental(const struct qas_corr_data *pdata, size_t band, size_t count, double *out)
+{
+	const double *indata = pdata->monitor_data + qas_window_size - QAS_CORR_SIZE;
+	double phase[count];
+	double dp[count];
+	double cos_in[count];
+	double sin_in[count];
+	size_t block;
+
+	/*
+	 * The newest block in the window belongs to the previous
+	 * frame. Frames queued before the last reset are not fed
+	 * into the sums.
+	 */
+	if (pdata->sequence_number == 0) {
+		for (size_t x = 0; x != count; x++)
+			out[x] = 1.0;
+		return;
+	}
+	block = pdata->sequence_number - 1;
+
+	for (size_t x = 0; x != count; x++) {
+		double block_phase;
+
+		dp[x] = qas_tuning * qas_freq_table[band + x * QAS_WAVE_STEP] / (double)qas_sample_rate;
+
+		block_phase = dp[x] * (double)QAS_CORR_SIZE;
+		block_phase -= floor(block_phase);
+		phase[x] = block_phase * (double)block;
+		phase[x] -= floor(phase[x]);
+	}
+
+	qas_ftt_multi(indata, QAS_CORR_SIZE, phase, dp, cos_in, sin_in, count);
+
+	pthread_mutex_lock(&qas_wave_sum_mutex);
+	if (pdata->sequence_number < qas_wave_sum_first) {
+		pthread_mutex_unlock(&qas_wave_sum_mutex);
+		for (size_t x = 0; x != count; x++)
+			out[x] = 1.0;
+		return;
+	}
+	for (size_t x = 0; x != count; x++) {
+		const size_t bi = band / QAS_WAVE_STEP + x;
+		struct qas_wave_sum *psum = qas_wave_sum_data + bi * qas_wave_sum_blocks;
+		struct qas_wave_sum *pslot = psum + (block % qas_wave_sum_blocks);
+
+		/* check if the tuning changed */
+		if (qas_wave_sum_phase[bi] != dp[x]) {
+			qas_wave_sum_phase[bi] = dp[x];
+			memset(psum, 0, sizeof(psum[0]) * qas_wave_sum_blocks);
+		}
+
+		/* don't let a late frame overwrite a newer block */
+		if (pslot->block <= block) {
+			pslot->cos_in = cos_in[x];
+			pslot->sin_in = sin_in[x];
+			pslot->block = block + 1;
+		}
+
+		/* sum the newest blocks covering the band length, skipping stale slots */
+		cos_in[x] = sin_in[x] = 0.0;
+		for (size_t y = 0; y != qas_wave_get_length(band + x * QAS_WAVE_STEP) / QAS_CORR_SIZE; y++) {
+			const size_t z = (block + qas_wave_sum_blocks - y) % qas_wave_sum_blocks;
+			if (y > block || psum[z].block != block - y + 1)
+				continue;
+			cos_in[x] += psum[z].cos_in;
+			sin_in[x] += psum[z].sin_in;
+		}
+	}
+	pthread_mutex_unlock(&qas_wave_sum_mutex);
+
+	for (size_t x = 0; x != count; x++) {
+		out[x] = (fabs(cos_in[x]) + fabs(sin_in[x])) /
+		    ((double)qas_wave_get_length(band + x * QAS_WAVE_STEP) * 0.5);
+		if (out[x] < 1.0)
+			out[x] = 1.0;
+	}
+}
+
+/*
+ * Analyze only the given band and its two neighbours, instead of
+ * running the full 1st scan. All other bands are cleared.
+ */
+void
+qas_wave_tuner(struct qas_corr_data *pdata, size_t band)
+{
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+
+	memset(pdata->band_data, 0, sizeof(pdata->band_data[0]) * table_size);
+
+	qas_wave_analyze_multi(pdata, (band - 1) * QAS_WAVE_STEP, QAS_WAVE_STEP, 3,
+	    pdata->band_data + band - 1);
+}
+
+/*
+ * Select the bands to analyze for the given frame in sparse mode.
+ * The values of skipped bands are filled in.
+ */
+void
+qas_wave_sparse_select(struct qas_corr_data *pdata, uint8_t *active)
+{
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+
+	pthread_mutex_lock(&qas_wave_sparse_mutex);
+	for (size_t x = 0; x != table_size; x++) {
+		/* bands near peaks are always analyzed */
+		if (qas_wave_band[x].quiet < QAS_WAVE_QUIET ||
+		    qas_wave_band[x].peak != 0 ||
+		    (x != 0 && qas_wave_band[x - 1].peak != 0) ||
+		    (x != table_size - 1 && qas_wave_band[x + 1].peak != 0) ||
+		    (pdata->sequence_number + x) % QAS_WAVE_QUIET == 0) {
+			active[x] = 1;
+		} else {
+			active[x] = 0;
+			pdata->band_data[x] = qas_wave_band[x].value;
+		}
+	}
+	pthread_mutex_unlock(&qas_wave_sparse_mutex);
+}
+
+/*
+ * Update the quiet band statistics, after the 1st scan of a frame.
+ */
+void
+qas_wave_sparse_update(const double *band_data, const uint8_t *peak, double level)
+{
+	const size_t table_size = qas_num_bands / QAS_WAVE_STEP;
+
+	pthread_mutex_lock(&qas_wave_sparse_mutex);
+	for (size_t x = 0; x != table_size; x++) {
+		qas_wave_band[x].value = band_data[x];
+		qas_wave_band[x].peak = peak[x];
+
+		if (band_data[x] >= level)
+			qas_wave_band[x].quiet = 0;
+		else if (qas_wave_band[x].quiet < QAS_WAVE_QUIET)
+			qas_wave_band[x].quiet++;
+	}
+	pthread_mutex_unlock(&qas_wave_sparse_mutex);
+}
+
+void
+qas_wave_reset()
+{
+	size_t first;
+
+	/* frames already handed out may still be analyzed after this */
+	atomic_lock();
+	first = qas_in_sequence_number;
+	atomic_unlock();
+
+	pthread_mutex_lock(&qas_wave_sum_mutex);
+	qas_wave_sum_first = first;
+	memset(qas_wave_sum_data, 0, sizeof(qas_wave_sum_data[0]) *
+	    (qas_num_bands / QAS_WAVE_STEP) * qas_wave_sum_blocks);
+	pthread_mutex_unlock(&qas_wave_sum_mutex);
+}
+
 static size_t
-qas_wave_analyze_binary_search(const double *indata, double *out, size_t band, size_t rem)
+qas_wave_analyze_binary_search(const struct qas_corr_data *pdata, double *out, size_t band, size_t rem)
 {
-	double dp;
 	double temp[1];
 	size_t pos = 0;
 
@@ -127,8 +528,7 @@ qas_wave_analyze_binary_search(const double *indata, double *out, size_t band, s
 	while (rem != 0) {
 		pos |= rem;
 
-		dp = qas_tuning * qas_freq_table[band + pos] / (double)qas_sample_rate;
-		qas_wave_analyze(indata, dp, temp);
+		qas_wave_analyze(pdata, band + pos, temp);
 		if (out[0] > temp[0])
 			pos &= ~rem;
 		else
@@ -138,6 +538,99 @@ qas_wave_analyze_binary_search(const double *indata, double *out, size_t band, s
 	return (pos);
 }
 
+/*
+ * Evaluate a few fixed offsets in a single pass and estimate the
+ * position of the maximum amplitude by fitting a parabola through
+ * the logarithm of the largest value and its two neighbours.
+ */
+#define	QAS_WAVE_REFINE 9
+
+static size_t
+qas_wave_analyze_interpolate(const struct qas_corr_data *pdata, double *out, size_t band)
+{
+	const size_t stride = QAS_WAVE_STEP / (QAS_WAVE_REFINE - 1);
+	double value[QAS_WAVE_REFINE];
+	double delta;
+	double denom;
+	double a, b, c;
+	size_t count;
+	size_t x;
+	ssize_t pos;
+
+	/* the last offset is the start of the next band, if any */
+	count = QAS_WAVE_REFINE;
+	while (band + (count - 1) * stride >= qas_num_bands)
+		count--;
+
+	qas_wave_analyze_multi(pdata, band, stride, count, value);
+
+	/* find the maximum */
+	for (size_t y = x = 0; y != count; y++) {
+		if (value[y] > value[x])
+			x = y;
+	}
+
+	/* check if the maximum is at an edge of this band */
+	if (x == 0) {
+		out[0] = value[0];
+		return (0);
+	} else if (x == QAS_WAVE_REFINE - 1) {
+		/* the maximum is in the next band */
+		out[0] = value[x - 1];
+		return ((x - 1) * stride);
+	} else if (x == count - 1) {
+		/* the last band has no successor to interpolate with */
+		out[0] = value[x];
+		return (x * stride);
+	}
+
+	a = log(value[x - 1]);
+	b = log(value[x]);
+	c = log(value[x + 1]);
+
+	denom = a - 2.0 * b + c;
+	if (denom < 0.0) {
+		delta = 0.5 * (a - c) / denom;
+		if (delta < -0.5)
+			delta = -0.5;
+		else if (delta > 0.5)
+			delta = 0.5;
+	} else {
+		delta = 0.0;
+	}
+
+	pos = (ssize_t)(x * stride) + (ssize_t)floor(delta * stride + 0.5);
+	if (pos > QAS_WAVE_STEP - 1)
+		pos = QAS_WAVE_STEP - 1;
+
+	out[0] = exp(b - 0.25 * (a - c) * delta);
+	return (pos);
+}
+
+static double
+qas_wave_time()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1000000000.0);
+}
+
+/*
+ * Returns the average time in seconds needed to refine one band.
+ */
+double
+qas_wave_refine_cost()
+{
+	double retval;
+
+	qas_wave_lock();
+	retval = qas_wave_refine_time;
+	qas_wave_unlock();
+
+	return (retval);
+}
+
 static void *
 qas_wave_worker(void *arg)
 {
@@ -145,22 +638,46 @@ qas_wave_worker(void *arg)
 
 	while (1) {
 		struct qas_wave_job *pjob;
+		double delta = 0.0;
 
 		pjob = qas_wave_job_dequeue();
 
 		switch (pjob->data->state) {
 		case QAS_STATE_1ST_SCAN:
-			qas_wave_analyze(pjob->data->monitor_data,
-			    qas_tuning * qas_freq_table[pjob->band_start] / (double)qas_sample_rate,
+			if (qas_wave_incremental &&
+			    pjob->data->engine == QAS_ENGINE_TRIANGLE) {
+				qas_wave_analyze_incremental(pjob->data,
+				    pjob->band_start, pjob->band_count,
+				    pjob->data->band_data + (pjob->band_start / QAS_WAVE_STEP));
+				break;
+			}
+			qas_wave_analyze_multi(pjob->data,
+			    pjob->band_start, QAS_WAVE_STEP, pjob->band_count,
 			    pjob->data->band_data + (pjob->band_start / QAS_WAVE_STEP));
 			break;
 		case QAS_STATE_2ND_SCAN:
+			delta = qas_wave_time();
+			if (qas_wave_interpolate) {
+				pjob->band_start +=
+				    qas_wave_analyze_interpolate(pjob->data,
+					pjob->data->band_data + (pjob->band_start / QAS_WAVE_STEP),
+					pjob->band_start);
+				break;
+			}
 			pjob->band_start +=
-			    qas_wave_analyze_binary_search(pjob->data->monitor_data,
+			    qas_wave_analyze_binary_search(pjob->data,
 			        pjob->data->band_data + (pjob->band_start / QAS_WAVE_STEP),
 			        pjob->band_start, QAS_WAVE_STEP / 2);
 			break;
 		}
+
+		if (pjob->data->state == QAS_STATE_2ND_SCAN) {
+			delta = qas_wave_time() - delta;
+
+			qas_wave_lock();
+			qas_wave_refine_time += (delta - qas_wave_refine_time) / 16.0;
+			qas_wave_unlock();
+		}
 		qas_display_job_insert(pjob);
 	}
 	return (0);
@@ -168,6 +685,55 @@ qas_wave_worker(void *arg)
 
 const double qas_base_freq = 440.0;	/* A-key in Hz */
 
+/*
+ * Return the band closest to the given frequency in Hz.
+ */
+size_t
+qas_wave_freq_to_band(double freq)
+{
+	double band;
+
+	if (freq <= 0.0)
+		return (0);
+
+	band = (log2(freq / qas_base_freq) + qas_low_octave) *
+	    (double)(12 * QAS_WAVE_STEP) + 0.5;
+	if (band < 0.0)
+		return (0);
+	else if (band > (double)(qas_num_bands - 1))
+		return (qas_num_bands - 1);
+	else
+		return ((size_t)band);
+}
+
+/*
+ * Return the description of the given band, like "C4" or "C4.128".
+ */
+QString
+qas_descr(size_t band)
+{
+	static const char *map[12] = {
+		"A%1", "B%1B", "B%1", "C%1",
+		"D%1B", "D%1", "E%1B", "E%1",
+		"F%1", "G%1B", "G%1", "A%1B"
+	};
+	QString retval = QString(map[(band / QAS_WAVE_STEP) % 12])
+	    .arg((band + 9 * QAS_WAVE_STEP) / (12 * QAS_WAVE_STEP));
+
+	if (band % QAS_WAVE_STEP) {
+		size_t y = 0;
+
+		/* bit-reverse the fraction */
+		for (size_t z = 1; z != QAS_WAVE_STEP; z *= 2) {
+			y *= 2;
+			if (band & z)
+				y |= 1;
+		}
+		retval += QString(".%1").arg(y);
+	}
+	return (retval);
+}
+
 void
 qas_wave_init()
 {
@@ -175,8 +741,13 @@ qas_wave_init()
 	const double max_hz = qas_sample_rate / 2.0;
 	double num_low_octave = 0;
 	double num_high_octave = 0;
+	double step;
+	double freq = 0;
+	double sum;
 
 	pthread_mutex_init(&qas_wave_mutex, 0);
+	pthread_mutex_init(&qas_wave_sum_mutex, 0);
+	pthread_mutex_init(&qas_wave_sparse_mutex, 0);
 	pthread_cond_init(&qas_wave_cond, 0);
 
 	while ((qas_base_freq * pow(2.0, -num_low_octave)) > min_hz)
@@ -194,42 +765,88 @@ qas_wave_init()
 	qas_low_octave = num_low_octave;
 	qas_num_bands = (size_t)(num_high_octave + num_low_octave) * 12 * QAS_WAVE_STEP;
 
+	/* analyze all bands by default */
+	qas_band_start = 0;
+	qas_band_stop = qas_num_bands;
+
 	qas_freq_table = (double *)malloc(sizeof(double) * qas_num_bands);
-	qas_descr_table = new QString [qas_num_bands];
+
+	/*
+	 * Compute the frequency table using a multiplicative
+	 * recurrence, which is re-anchored at every octave to avoid
+	 * accumulating rounding errors:
+	 */
+	step = pow(2.0, 1.0 / (double)(12 * QAS_WAVE_STEP));
 
 	for (size_t x = 0; x != qas_num_bands; x++) {
-		const char *map[12] = {
-			"A%1", "B%1B", "B%1", "C%1",
-			"D%1B", "D%1", "E%1B", "E%1",
-			"F%1", "G%1B", "G%1", "A%1B"
-		};
-		qas_freq_table[x] = qas_base_freq *
-		    pow(2.0, (double)x / (double)(12 * QAS_WAVE_STEP) - num_low_octave);
-		qas_descr_table[x] = QString(map[(x / QAS_WAVE_STEP) % 12])
-		    .arg((x + 9 * QAS_WAVE_STEP) / (12 * QAS_WAVE_STEP));
-
-		if (x % QAS_WAVE_STEP) {
-			size_t y = 0;
-			if (x & 1)
-				y |= 128;
-			if (x & 2)
-				y |= 64;
-			if (x & 4)
-				y |= 32;
-			if (x & 8)
-				y |= 16;
-			if (x & 16)
-				y |= 8;
-			if (x & 32)
-				y |= 4;
-			if (x & 64)
-				y |= 2;
-			if (x & 128)
-				y |= 1;
-			qas_descr_table[x] += QString(".%1").arg(y);
+		if (x % (12 * QAS_WAVE_STEP) == 0) {
+			freq = qas_base_freq *
+			    pow(2.0, (double)(x / (12 * QAS_WAVE_STEP)) - num_low_octave);
+		} else {
+			freq *= step;
 		}
+		qas_freq_table[x] = freq;
+	}
+
+	/* compute the half-band filter, using a Blackman window */
+	for (size_t j = 0; j != QAS_WAVE_HALF_BAND; j++) {
+		const double k = 2 * j + 1;
+		const double w = 0.42 + 0.5 * cos(M_PI * k / (2.0 * QAS_WAVE_HALF_BAND)) +
+		    0.08 * cos(2.0 * M_PI * k / (2.0 * QAS_WAVE_HALF_BAND));
+
+		qas_wave_half_band[j] = w * sin(M_PI * k / 2.0) / (M_PI * k);
+	}
+
+	/* normalize the DC gain to one */
+	sum = 0.0;
+	for (size_t j = 0; j != QAS_WAVE_HALF_BAND; j++)
+		sum += 2.0 * qas_wave_half_band[j];
+	for (size_t j = 0; j != QAS_WAVE_HALF_BAND; j++)
+		qas_wave_half_band[j] *= 0.5 / sum;
+
+	/* compute the decimation level for each band */
+	qas_wave_level = (uint8_t *)malloc(qas_num_bands / QAS_WAVE_STEP);
+	qas_wave_level_max = 0;
+
+	for (size_t x = 0; x != qas_num_bands / QAS_WAVE_STEP; x++) {
+		uint8_t level = 0;
+
+		while (level < QAS_WAVE_LEVEL_MAX &&
+		    (qas_window_size % (2U << level)) == 0 &&
+		    4.0 * qas_freq_table[x * QAS_WAVE_STEP] <= (double)(qas_sample_rate >> (level + 1)))
+			level++;
+
+		qas_wave_level[x] = level;
+		if (qas_wave_level_max < level)
+			qas_wave_level_max = level;
+	}
+
+	/* compute the constant-Q analysis length for each band */
+	qas_wave_length = (size_t *)malloc(sizeof(size_t) * (qas_num_bands / QAS_WAVE_STEP));
+
+	for (size_t x = 0; x != qas_num_bands / QAS_WAVE_STEP; x++) {
+		size_t length = ceil(QAS_WAVE_PERIODS * (double)qas_sample_rate /
+		    qas_freq_table[x * QAS_WAVE_STEP]);
+
+		length += QAS_CORR_SIZE - 1;
+		length -= length % QAS_CORR_SIZE;
+
+		if (length > qas_window_size)
+			length = qas_window_size;
+		qas_wave_length[x] = length;
 	}
 
+	qas_wave_band = (struct qas_wave_band *)malloc(sizeof(qas_wave_band[0]) *
+	    (qas_num_bands / QAS_WAVE_STEP));
+	memset(qas_wave_band, 0, sizeof(qas_wave_band[0]) * (qas_num_bands / QAS_WAVE_STEP));
+
+	qas_wave_sum_blocks = qas_window_size / QAS_CORR_SIZE;
+	qas_wave_sum_data = (struct qas_wave_sum *)malloc(sizeof(qas_wave_sum_data[0]) *
+	    (qas_num_bands / QAS_WAVE_STEP) * qas_wave_sum_blocks);
+	qas_wave_sum_phase = (double *)malloc(sizeof(double) * (qas_num_bands / QAS_WAVE_STEP));
+	memset(qas_wave_sum_phase, 0, sizeof(double) * (qas_num_bands / QAS_WAVE_STEP));
+	qas_wave_reset();
+
 	for (int i = 0; i != qas_num_workers; i++) {
 		pthread_t qas_wave_thread;
 		pthread_create(&qas_wave_thread, 0, &qas_wave_worker, 0);
@@ -0,0 +1,164 @@
+/*-
+ * Copyright (c) 2022 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "qaudiosonar.h"
+
+/*
+ * The YIN pitch estimator, see "YIN, a fundamental frequency
+ * estimator for speech and music" by A. de Cheveigne and H. Kawahara.
+ */
+#define	QAS_YIN_SIZE_MAX 2048	/* samples */
+#define	QAS_YIN_THRESHOLD 0.15
+#define	QAS_YIN_FREQ_MAX 4000.0	/* Hz */
+
+static size_t qas_yin_size;
+
+/*
+ * Work space of each thread. It only grows, and is kept for the
+ * lifetime of the thread.
+ */
+static thread_local double *qas_yin_buffer;
+static thread_local size_t qas_yin_buffer_size;
+
+static double *
+qas_yin_buffer_get(size_t size)
+{
+	if (qas_yin_buffer_size < size) {
+		double *ptr = (double *)realloc(qas_yin_buffer, sizeof(double) * size);
+
+		if (ptr == 0)
+			return (0);
+		qas_yin_buffer = ptr;
+		qas_yin_buffer_size = size;
+	}
+	return (qas_yin_buffer);
+}
+
+/*
+ * Estimate the fundamental frequency of the newest input samples.
+ * Returns the band of the fundamental, or zero if the input is not
+ * periodic. The amplitude of the input is stored in "pamp".
+ */
+size_t
+qas_yin_analyze(const struct qas_corr_data *pdata, double *pamp)
+{
+	const size_t n = qas_yin_size;
+	const double *in = pdata->monitor_data + qas_window_size - 2 * n;
+	double *buffer;
+	double *va;
+	double *vb;
+	double *vc;
+	double *d;
+	double *r;
+	double energy;
+	double freq;
+	double sum;
+	double a, b, c;
+	double delta;
+	size_t tau_min;
+	size_t tau;
+
+	*pamp = 0.0;
+
+	buffer = qas_yin_buffer_get(9 * n);
+	if (buffer == 0)
+		return (0);
+
+	va = buffer;
+	vb = va + 2 * n;
+	vc = vb + 2 * n;
+	d = vc + 4 * n;
+	r = vc + n - 1;
+
+	for (size_t x = 0; x != 2 * n; x++) {
+		va[x] = in[x];
+		vb[x] = (x < n) ? in[n - 1 - x] : 0.0;
+	}
+
+	/* compute the autocorrelation, "r[tau]" */
+	memset(vc, 0, sizeof(double) * 4 * n);
+	qas_conv_double(va, vb, vc, 2 * n);
+
+	if (r[0] < 1.0)
+		return (0);
+
+	/* compute the cumulative mean normalized difference function */
+	energy = r[0];
+	sum = 0.0;
+	d[0] = 1.0;
+
+	for (tau = 1; tau != n; tau++) {
+		double diff;
+
+		energy += in[tau + n - 1] * in[tau + n - 1] - in[tau - 1] * in[tau - 1];
+
+		diff = r[0] + energy - 2.0 * r[tau];
+		if (diff < 0.0)
+			diff = 0.0;
+		sum += diff;
+
+		d[tau] = (sum > 0.0) ? (diff * (double)tau / sum) : 1.0;
+	}
+
+	tau_min = qas_sample_rate / QAS_YIN_FREQ_MAX;
+	if (tau_min < 2)
+		tau_min = 2;
+
+	/* find the first dip below the threshold */
+	for (tau = tau_min; tau < n - 1; tau++) {
+		if (d[tau] >= QAS_YIN_THRESHOLD)
+			continue;
+		while (tau + 1 < n - 1 && d[tau + 1] < d[tau])
+			tau++;
+		break;
+	}
+	if (tau >= n - 1)
+		return (0);
+
+	/* parabolic interpolation of the dip */
+	a = d[tau - 1];
+	b = d[tau];
+	c = d[tau + 1];
+
+	delta = a - 2.0 * b + c;
+	if (delta > 0.0)
+		delta = 0.5 * (a - c) / delta;
+	else
+		delta = 0.0;
+
+	freq = (double)qas_sample_rate / ((double)tau + delta);
+
+	*pamp = sqrt(2.0 * r[0] / (double)n);
+
+	return (qas_wave_freq_to_band(freq / qas_tuning));
+}
+
+void
+qas_yin_init()
+{
+	qas_yin_size = QAS_YIN_SIZE_MAX;
+	while (2 * qas_yin_size > qas_window_size)
+		qas_yin_size /= 2;
+}